@@ -16,13 +16,24 @@ HEADERS += \
     src/settings.h \
     src/uploader.h \
     src/util/formattedstring.h \
+    src/util/hdatabinding.h \
     src/util/messagelistfilter.h \
     src/util/nicklistfilter.h \
+    src/util/objectpool.h \
     src/weechat.h \
     src/common.h \
     src/windowhelper.h \
     src/util/colortheme.h \
-    src/util/sockethelper.h
+    src/util/sockethelper.h \
+    src/util/scrollbackcache.h \
+    src/util/searchindex.h \
+    src/util/messageitem.h \
+    src/util/tagdictionary.h \
+    src/util/messagelayout.h \
+    src/util/timestampformatter.h \
+    src/util/nickcompleter.h \
+    src/util/collapsedlinelist.h \
+    src/util/framescheduler.h
 
 SOURCES += \
     src/lith.cpp \
@@ -39,7 +50,16 @@ SOURCES += \
     src/weechat.cpp \
     src/windowhelper.cpp \
     src/util/colortheme.cpp \
-    src/util/sockethelper.cpp
+    src/util/sockethelper.cpp \
+    src/util/scrollbackcache.cpp \
+    src/util/searchindex.cpp \
+    src/util/messageitem.cpp \
+    src/util/tagdictionary.cpp \
+    src/util/messagelayout.cpp \
+    src/util/timestampformatter.cpp \
+    src/util/nickcompleter.cpp \
+    src/util/collapsedlinelist.cpp \
+    src/util/framescheduler.cpp
 
 
 INCLUDEPATH += \
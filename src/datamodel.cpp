@@ -21,24 +21,98 @@
 #include "weechat.h"
 #include "lith.h"
 #include "windowhelper.h"
+#include "util/scrollbackcache.h"
+#include "util/searchindex.h"
+#include "util/messagelayout.h"
 
 #include <QUrl>
 #include <QApplication>
-#include <QTextDocumentFragment>
 #include <QXmlStreamReader>
 #include <QDomDocument>
 
+#include <utility>
+
+static constexpr HDataBinding<Buffer>::Entry bufferBindings[] {
+    HDATA_BIND(Buffer, number),
+    HDATA_BIND(Buffer, name),
+    HDATA_BIND_AS(Buffer, "full_name", name),
+    HDATA_BIND(Buffer, short_name),
+    HDATA_BIND(Buffer, title),
+    HDATA_BIND(Buffer, local_variables),
+    HDATA_IGNORE("hidden"),
+    HDATA_IGNORE("nicklist"),
+    HDATA_IGNORE("prev_buffer"),
+    HDATA_IGNORE("next_buffer"),
+};
+const HDataBinding<Buffer> Buffer::hdataBinding { bufferBindings };
+
+static constexpr HDataBinding<BufferLine>::Entry bufferLineBindings[] {
+    HDATA_BIND(BufferLine, date),
+    HDATA_BIND(BufferLine, displayed),
+    HDATA_BIND(BufferLine, highlight),
+    HDATA_BIND(BufferLine, tags_array),
+    HDATA_BIND(BufferLine, prefix),
+    HDATA_BIND(BufferLine, message),
+    // the parent buffer is resolved by the caller
+    HDATA_IGNORE("buffer"),
+    HDATA_IGNORE("date_printed"),
+    HDATA_IGNORE("notify_level"),
+    HDATA_IGNORE("prefix_length"),
+    HDATA_IGNORE("refresh_needed"),
+    HDATA_IGNORE("str_time"),
+    HDATA_IGNORE("y"),
+};
+const HDataBinding<BufferLine> BufferLine::hdataBinding { bufferLineBindings };
+
+static constexpr HDataBinding<Nick>::Entry nickBindings[] {
+    HDATA_BIND(Nick, visible),
+    HDATA_BIND(Nick, group),
+    HDATA_BIND(Nick, level),
+    HDATA_BIND(Nick, name),
+    HDATA_BIND(Nick, color),
+    HDATA_BIND(Nick, prefix),
+    HDATA_BIND(Nick, prefix_color),
+    HDATA_IGNORE("_diff"),
+};
+const HDataBinding<Nick> Nick::hdataBinding { nickBindings };
+
+static constexpr HDataBinding<HotListItem>::Entry hotListItemBindings[] {
+    HDATA_BIND(HotListItem, count),
+    // the buffer is resolved by the caller
+    HDATA_IGNORE("buffer"),
+    HDATA_IGNORE("priority"),
+    HDATA_IGNORE("creation_time.tv_sec"),
+    HDATA_IGNORE("creation_time.tv_usec"),
+};
+const HDataBinding<HotListItem> HotListItem::hdataBinding { hotListItemBindings };
+
+qint64 Buffer::s_totalDeferredBytes = 0;
+
 Buffer::Buffer(Lith *parent, pointer_t pointer)
     : QObject(parent)
     , m_lines(QmlObjectList::create<BufferLine>(this))
     , m_nicks(QmlObjectList::create<Nick>(this))
-    , m_proxyLinesFiltered(new MessageFilterList(this, m_lines))
     , m_ptr(pointer)
 {
-
+    // delegates and QML references may still hold removed lines and nicks, they can't be reused,
+    // deleteLater lets them see the object is gone instead
+    auto deleter = [](QObject *object) { object->deleteLater(); };
+    m_lines->setDeleter(deleter);
+    m_nicks->setDeleter(deleter);
 }
 
 Buffer::~Buffer() {
+    s_totalDeferredBytes -= m_deferredBytes;
+    // the queued lines and nicks never made it into the models
+    qDeleteAll(m_pendingLines);
+    for (auto &diff : m_pendingNickDiffs) {
+        if (diff.nick)
+            ObjectPool<Nick>::instance().release(diff.nick);
+    }
+    if (lith()) {
+        for (int i = 0; i < m_lines->count(); i++)
+            lith()->searchIndex()->remove(m_lines->get<BufferLine>(i));
+    }
     m_nicks->clear();
     m_lines->clear();
 }
@@ -47,12 +121,208 @@ Lith *Buffer::lith() {
     return qobject_cast<Lith*>(parent());
 }
 
+pointer_t Buffer::ptrGet() const {
+    return m_ptr;
+}
+
 void Buffer::prependLine(BufferLine *line) {
-    m_lines->prepend(line);
+    prependLines({ line });
+}
+
+void Buffer::prependLines(const QList<BufferLine *> &lines) {
+    if (lines.isEmpty())
+        return;
+    // the newest line is the first row
+    QList<BufferLine*> rows(lines.crbegin(), lines.crend());
+    m_lines->prependRange(rows);
+    m_hotlistCleared = false;
+    for (auto line : lines) {
+        storeLine(line);
+        noteActivity(line);
+        lith()->searchIndex()->add(line);
+    }
+    prepareLayouts(0, lines.count());
+}
+
+void Buffer::queueLine(BufferLine *line) {
+    m_pendingLines.append(line);
+    lith()->scheduleUpdate(this);
+}
+
+void Buffer::queueNickDiff(char op, pointer_t ptr, Nick *nick) {
+    m_pendingNickDiffs.append({ op, ptr, nick });
+    lith()->scheduleUpdate(this);
+}
+
+void Buffer::flushPendingUpdates() {
+    if (!m_pendingLines.isEmpty())
+        prependLines(std::exchange(m_pendingLines, {}));
+    if (!m_pendingNickDiffs.isEmpty())
+        applyNickDiffs(std::exchange(m_pendingNickDiffs, {}));
+}
+
+void Buffer::deferLine(const ScrollbackCache::Record &record) {
+    // the line could otherwise be lost if the application quits before it's shown
+    if (m_scrollback)
+        m_scrollback->append(record);
+    auto bytes = ScrollbackCache::serialize(record);
+    m_deferredBytes += bytes.size();
+    s_totalDeferredBytes += bytes.size();
+    m_deferredLines.append(bytes);
+}
+
+QList<ScrollbackCache::Record> Buffer::deferredLines() const {
+    QList<ScrollbackCache::Record> result;
+    result.reserve(m_deferredLines.count());
+    for (auto &i : m_deferredLines) {
+        ScrollbackCache::Record record;
+        if (ScrollbackCache::deserialize(i, record))
+            result.append(record);
+    }
+    return result;
+}
+
+QList<ScrollbackCache::Record> Buffer::takeDeferredLines() {
+    auto result = deferredLines();
+    m_deferredLines.clear();
+    s_totalDeferredBytes -= m_deferredBytes;
+    m_deferredBytes = 0;
+    return result;
+}
+
+qint64 Buffer::deferredBytes() const {
+    return m_deferredBytes;
+}
+
+qint64 Buffer::totalDeferredBytes() {
+    return s_totalDeferredBytes;
+}
+
+void Buffer::countUnreadLine(bool highlight, const QStringList &tags) {
+    // highlights and private messages are what HotListItem counts as hot
+    if (highlight || tags.contains("notify_private"))
+        hotMessagesSet(hotMessagesGet() + 1);
+    else if (tags.contains("notify_message"))
+        unreadMessagesSet(unreadMessagesGet() + 1);
 }
 
 void Buffer::appendLine(BufferLine *line) {
-    m_lines->append(line);
+    appendLines({ line });
+}
+
+void Buffer::appendLines(const QList<BufferLine *> &lines) {
+    // fetched lines are still newer than the ones restored from disk
+    const int first = m_lines->count() - m_cachedLineCount;
+    m_lines->insertRange(first, lines);
+    for (auto line : lines) {
+        storeLine(line);
+        noteActivity(line);
+        lith()->searchIndex()->add(line);
+    }
+    prepareLayouts(first, lines.count());
+}
+
+void Buffer::openScrollback() {
+    if (m_scrollback || !lith()->settingsGet()->scrollbackCacheGet())
+        return;
+    // there's no user in the relay protocol, the endpoint tells apart relays behind the same websocket server
+    auto settings = lith()->settingsGet();
+    auto relay = QString("%1:%2/%3").arg(settings->hostGet()).arg(settings->portGet()).arg(settings->useWebsocketsGet() ? settings->websocketsEndpointGet() : QString());
+    ScrollbackCache::setTotalLimit(settings->scrollbackCacheTotalSizeGet() * 1024LL);
+    m_scrollback = new ScrollbackCache(relay, nameGet().toPlain(), settings->scrollbackCacheSizeGet() * 1024LL, this);
+}
+
+void Buffer::restoreScrollback() {
+    openScrollback();
+    if (!m_scrollback || m_scrollbackRestored)
+        return;
+    m_scrollbackRestored = true;
+    // lines received before the buffer was shown are probably on the disk as well
+    QSet<QPair<qint64, QString>> known;
+    for (int i = 0; i < m_lines->count(); i++) {
+        auto line = m_lines->get<BufferLine>(i);
+        known.insert(qMakePair(line->dateGet().toSecsSinceEpoch(), line->prefixGet().toPlain() + line->messageGet().toPlain()));
+    }
+    QList<BufferLine*> lines;
+    for (auto &i : m_scrollback->load()) {
+        if (known.contains(qMakePair(i.date.toSecsSinceEpoch(), i.prefix.toPlain() + i.message.toPlain())))
+            continue;
+        auto line = createLine(i);
+        lith()->searchIndex()->add(line);
+        lines.append(line);
+    }
+    m_lines->appendRange(lines);
+    m_cachedLineCount += lines.count();
+}
+
+BufferLine *Buffer::createLine(const ScrollbackCache::Record &record) {
+    auto line = new BufferLine(this);
+    line->ptrSet(record.ptr);
+    line->dateSet(record.date);
+    line->displayedSet(record.displayed);
+    line->highlightSet(record.highlight);
+    line->tags_arraySet(record.tags);
+    line->prefixSet(record.prefix);
+    line->messageSet(record.message);
+    return line;
+}
+
+bool Buffer::isCached(const QDateTime &date, const FormattedString &prefix, const FormattedString &message) const {
+    return m_scrollback && !m_scrollbackGap && !m_scrollback->isEmpty() && m_scrollback->contains(date, prefix, message);
+}
+
+void Buffer::dropCachedLines() {
+    m_scrollbackGap = true;
+    if (m_cachedLineCount == 0)
+        return;
+    const int first = m_lines->count() - m_cachedLineCount;
+    for (int i = first; i < m_lines->count(); i++)
+        lith()->searchIndex()->remove(m_lines->get<BufferLine>(i));
+    m_lines->removeRange(first, m_cachedLineCount);
+    m_cachedLineCount = 0;
+}
+
+void Buffer::storeLine(BufferLine *line) {
+    if (!m_scrollback)
+        return;
+    m_scrollback->append({
+        line->dateGet(),
+        line->ptrGet(),
+        line->displayedGet(),
+        line->highlightGet(),
+        line->tags_arrayGet(),
+        line->prefixGet(),
+        line->messageGet()
+    });
+}
+
+void Buffer::noteActivity(BufferLine *line) {
+    if (line->isPrivMsgGet())
+        m_nickCompleter.noteActivity(line->nickGet(), line->dateGet().toMSecsSinceEpoch());
+}
+
+void Buffer::prepareLayouts(int first, int count) {
+    if (lith()->selectedBuffer() != this)
+        return;
+    auto settings = lith()->settingsGet();
+    const bool showJoinPartQuit = settings->showJoinPartQuitMessagesGet();
+    const bool collapseJoinPartQuit = settings->collapseJoinPartQuitMessagesGet();
+    auto isJoinPartQuit = [this](int row) {
+        return row >= 0 && row < m_lines->count() && m_lines->get<BufferLine>(row)->isJoinPartQuitMsgGet();
+    };
+    QList<MessageLayout::Input> inputs;
+    for (int i = first; i < first + count; i++) {
+        auto line = m_lines->get<BufferLine>(i);
+        if (line->isJoinPartQuitMsgGet()) {
+            if (!showJoinPartQuit)
+                continue;
+            // two of them in a row get folded under a summary by CollapsedLineList
+            if (collapseJoinPartQuit && (isJoinPartQuit(i - 1) || isJoinPartQuit(i + 1)))
+                continue;
+        }
+        inputs.append({ line->timestampGet(), line->prefixGet(), line->messageGet() });
+    }
+    MessageLayout::precompute(inputs);
 }
 
 FormattedString Buffer::titleGet() const {
@@ -70,6 +340,51 @@ bool Buffer::isAfterInitialFetch() {
     return m_afterInitialFetch;
 }
 
+void Buffer::oldestLineSet(pointer_t ptr, const QDateTime &date) {
+    if (!m_oldestLinePtr) {
+        m_oldestLinePtr = ptr;
+        m_oldestLineDate = date;
+    }
+}
+
+void Buffer::linesFetched(pointer_t oldestLinePtr, const QDateTime &oldestLineDate, int count, bool reachedCache) {
+    m_fetchInProgress = false;
+    if (reachedCache) {
+        // everything older is already restored from disk
+        m_historyComplete = true;
+        return;
+    }
+    if (count < m_lastRequestedCount)
+        m_historyComplete = true;
+    if (oldestLinePtr) {
+        m_oldestLinePtr = oldestLinePtr;
+        m_oldestLineDate = oldestLineDate;
+    }
+}
+
+pointer_t Buffer::oldestLineGet() const {
+    return m_oldestLinePtr;
+}
+
+QDateTime Buffer::oldestLineDateGet() const {
+    return m_oldestLineDate;
+}
+
+void Buffer::fetchLinesBeforeOldest() {
+    // the reply contains the line we're paging from as well
+    m_lastRequestedCount = c_linesPerFetch + 1;
+    QMetaObject::invokeMethod(Lith::instance()->weechat(), "fetchLinesBefore", Q_ARG(pointer_t, m_ptr), Q_ARG(pointer_t, m_oldestLinePtr), Q_ARG(int, m_lastRequestedCount));
+}
+
+void Buffer::resetOldestLine() {
+    m_oldestLinePtr = 0;
+    m_oldestLineDate = QDateTime();
+    if (!m_fetchInProgress)
+        return;
+    m_lastRequestedCount = m_lines->count() + c_linesPerFetch;
+    QMetaObject::invokeMethod(Lith::instance()->weechat(), "fetchLines", Q_ARG(pointer_t, m_ptr), Q_ARG(int, m_lastRequestedCount));
+}
+
 QmlObjectList *Buffer::lines() {
     return m_lines;
 }
@@ -99,6 +414,16 @@ Nick *Buffer::getNick(pointer_t ptr) {
 void Buffer::addNick(pointer_t ptr, Nick *nick) {
     nick->ptrSet(ptr);
     m_nicks->append(nick);
+    m_nickCompleter.add(nick);
+    emit nicksChanged();
+}
+
+void Buffer::addNicks(const QList<Nick *> &nicks) {
+    if (nicks.isEmpty())
+        return;
+    m_nicks->appendRange(nicks);
+    for (auto nick : nicks)
+        m_nickCompleter.add(nick);
     emit nicksChanged();
 }
 
@@ -106,6 +431,7 @@ void Buffer::removeNick(pointer_t ptr) {
     for (int i = 0; i < m_nicks->count(); i++) {
         auto n = m_nicks->get<Nick>(i);
         if (n && n->ptrGet() == ptr) {
+            m_nickCompleter.remove(n);
             m_nicks->removeRow(i);
             emit nicksChanged();
             break;
@@ -114,10 +440,117 @@ void Buffer::removeNick(pointer_t ptr) {
 }
 
 void Buffer::clearNicks() {
+    m_nickCompleter.clear();
     m_nicks->clear();
     emit nicksChanged();
 }
 
+void Buffer::reconcileNicks(const QList<Nick *> &snapshot) {
+    const int existingCount = m_nicks->count();
+    // pointers don't survive reconnects, the name is used as a fallback
+    QHash<pointer_t, int> rowsByPtr;
+    QHash<QString, int> rowsByKey;
+    rowsByPtr.reserve(existingCount);
+    rowsByKey.reserve(existingCount);
+    for (int i = 0; i < existingCount; i++) {
+        auto n = m_nicks->get<Nick>(i);
+        rowsByPtr.insert(n->ptrGet(), i);
+        rowsByKey.insert(n->key(), i);
+    }
+
+    QVector<bool> keep(existingCount, false);
+    QVector<int> matchedRows(snapshot.count(), -1);
+    for (int i = 0; i < snapshot.count(); i++) {
+        int row = rowsByPtr.value(snapshot[i]->ptrGet(), -1);
+        if (row < 0 || keep[row])
+            row = rowsByKey.value(snapshot[i]->key(), -1);
+        if (row >= 0 && !keep[row]) {
+            keep[row] = true;
+            matchedRows[i] = row;
+        }
+    }
+
+    // the rows that stay are only patched in place, which keeps the snapshot order only if they're already in it
+    int previousRow = -1;
+    for (int row : matchedRows) {
+        if (row < 0)
+            continue;
+        if (row < previousRow) {
+            // a nick moved to another group or the diffs appended nicks out of order, start over
+            m_nickCompleter.clear();
+            m_nicks->clear();
+            m_nicks->appendRange(snapshot);
+            for (auto nick : snapshot)
+                m_nickCompleter.add(nick);
+            emit nicksChanged();
+            return;
+        }
+        previousRow = row;
+    }
+
+    bool changed = false;
+
+    // update the nicks that stay, contiguous changed rows are reported at once
+    QVector<bool> updated(existingCount, false);
+    for (int i = 0; i < snapshot.count(); i++) {
+        int row = matchedRows[i];
+        if (row < 0)
+            continue;
+        auto existing = m_nicks->get<Nick>(row);
+        existing->ptrSet(snapshot[i]->ptrGet());
+        updated[row] = existing->updateFrom(*snapshot[i]);
+        if (updated[row])
+            m_nickCompleter.update(existing);
+        ObjectPool<Nick>::instance().release(snapshot[i]);
+    }
+    for (int row = 0; row < existingCount; row++) {
+        if (!updated[row])
+            continue;
+        int last = row;
+        while (last + 1 < existingCount && updated[last + 1])
+            last++;
+        m_nicks->refresh(row, last);
+        changed = true;
+        row = last;
+    }
+
+    // remove the ones that are gone, from the back so the rows stay valid
+    for (int row = existingCount - 1; row >= 0; row--) {
+        if (keep[row])
+            continue;
+        int first = row;
+        while (first > 0 && !keep[first - 1])
+            first--;
+        for (int i = first; i <= row; i++)
+            m_nickCompleter.remove(m_nicks->get<Nick>(i));
+        m_nicks->removeRange(first, row - first + 1);
+        changed = true;
+        row = first;
+    }
+
+    // insert the new ones at their position in the snapshot
+    QList<Nick*> batch;
+    int batchStart = 0;
+    for (int i = 0; i <= snapshot.count(); i++) {
+        if (i < snapshot.count() && matchedRows[i] < 0) {
+            if (batch.isEmpty())
+                batchStart = i;
+            batch.append(snapshot[i]);
+            continue;
+        }
+        if (!batch.isEmpty()) {
+            m_nicks->insertRange(qMin(batchStart, m_nicks->count()), batch);
+            for (auto nick : batch)
+                m_nickCompleter.add(nick);
+            batch.clear();
+            changed = true;
+        }
+    }
+
+    if (changed)
+        emit nicksChanged();
+}
+
 QStringList Buffer::getVisibleNicks() {
     QStringList result;
     for (int i = 0; i < m_nicks->count(); i++) {
@@ -129,6 +562,76 @@ QStringList Buffer::getVisibleNicks() {
     return result;
 }
 
+void Buffer::applyNickDiffs(const QList<NickDiff> &diffs) {
+    bool changed = false;
+    // runs of the same operation (a netsplit, a mass voice) go into the model at once, the runs stay in order
+    for (int i = 0; i < diffs.count(); ) {
+        int end = i + 1;
+        while (end < diffs.count() && diffs[end].op == diffs[i].op)
+            end++;
+        switch (diffs[i].op) {
+        case '+': {
+            QList<Nick*> added;
+            for (int j = i; j < end; j++) {
+                diffs[j].nick->ptrSet(diffs[j].ptr);
+                added.append(diffs[j].nick);
+            }
+            m_nicks->appendRange(added);
+            for (auto nick : added)
+                m_nickCompleter.add(nick);
+            changed = true;
+            break;
+        }
+        case '-': {
+            QSet<pointer_t> removed;
+            for (int j = i; j < end; j++)
+                removed.insert(diffs[j].ptr);
+            // from the back so the rows stay valid, contiguous rows are removed at once
+            for (int row = m_nicks->count() - 1; row >= 0; row--) {
+                if (!removed.contains(m_nicks->get<Nick>(row)->ptrGet()))
+                    continue;
+                int first = row;
+                while (first > 0 && removed.contains(m_nicks->get<Nick>(first - 1)->ptrGet()))
+                    first--;
+                for (int r = first; r <= row; r++)
+                    m_nickCompleter.remove(m_nicks->get<Nick>(r));
+                m_nicks->removeRange(first, row - first + 1);
+                changed = true;
+                row = first;
+            }
+            break;
+        }
+        default: {
+            // '*' carries the whole nick, it gets copied into the one in the list
+            QHash<pointer_t, int> rows;
+            rows.reserve(m_nicks->count());
+            for (int row = 0; row < m_nicks->count(); row++)
+                rows.insert(m_nicks->get<Nick>(row)->ptrGet(), row);
+            for (int j = i; j < end; j++) {
+                const int row = rows.value(diffs[j].ptr, -1);
+                if (row >= 0) {
+                    auto existing = m_nicks->get<Nick>(row);
+                    if (existing->updateFrom(*diffs[j].nick)) {
+                        m_nickCompleter.update(existing);
+                        m_nicks->refresh(row, row);
+                        changed = true;
+                    }
+                }
+                ObjectPool<Nick>::instance().release(diffs[j].nick);
+            }
+            break;
+        }
+        }
+        i = end;
+    }
+    if (changed)
+        emit nicksChanged();
+}
+
+QStringList Buffer::complete(const QString &prefix, int n) const {
+    return m_nickCompleter.complete(prefix, n);
+}
+
 int Buffer::normalsGet() const {
     int total = 0;
     for (int i = 0; i < m_nicks->count(); i++) {
@@ -186,11 +689,33 @@ bool Buffer::isPrivateGet() const {
 }
 
 MessageFilterList *Buffer::lines_filtered() {
+    if (!m_proxyLinesFiltered)
+        m_proxyLinesFiltered = new MessageFilterList(this, m_lines);
     return m_proxyLinesFiltered;
 }
 
+CollapsedLineList *Buffer::lines_collapsed() {
+    if (!m_linesCollapsed)
+        m_linesCollapsed = new CollapsedLineList(this, lines_filtered());
+    return m_linesCollapsed;
+}
+
+void Buffer::releaseLineModels() {
+    if (!m_proxyLinesFiltered)
+        return;
+    // QML can still be holding them, they only stop following the lines right away
+    m_proxyLinesFiltered->setSourceModel(nullptr);
+    m_proxyLinesFiltered->deleteLater();
+    m_proxyLinesFiltered = nullptr;
+    if (m_linesCollapsed) {
+        m_linesCollapsed->deleteLater();
+        m_linesCollapsed = nullptr;
+    }
+    emit lineModelsChanged();
+}
+
 bool Buffer::input(const QString &data) {
-    if (Lith::instance()->statusGet() == Lith::CONNECTED) {
+    if (Lith::instance()->statusGet() == Lith::CONNECTED && m_ptr) {
         bool success = false;
         QList<bool> success_list;
 
@@ -208,28 +733,39 @@ bool Buffer::input(const QString &data) {
 
 void Buffer::fetchMoreLines() {
     m_afterInitialFetch = true;
-    if (m_lines->count() >= m_lastRequestedCount) {
-        QMetaObject::invokeMethod(Lith::instance()->weechat(), "fetchLines", Q_ARG(pointer_t, m_ptr), Q_ARG(int, m_lines->count() + 25));
-        //Lith::instance()->weechat()->fetchLines(m_ptr, m_lines->count() + 25);
-        m_lastRequestedCount = m_lines->count() + 25;
+    // fillTopOfList asks for more lines very often, only keep one request per buffer on the wire.
+    // Buffers restored from disk before connecting don't exist on the relay
+    if (m_fetchInProgress || m_historyComplete || !m_ptr)
+        return;
+    m_fetchInProgress = true;
+    if (m_oldestLinePtr) {
+        // WeeChat has nothing to check a bare line pointer against, the oldest lines of the buffer tell whether it was trimmed
+        m_lastRequestedCount = c_linesPerFetch + 1;
+        QMetaObject::invokeMethod(Lith::instance()->weechat(), "fetchOldestLines", Q_ARG(pointer_t, m_ptr), Q_ARG(int, m_lastRequestedCount));
+    }
+    else {
+        m_lastRequestedCount = m_lines->count() + c_linesPerFetch;
+        QMetaObject::invokeMethod(Lith::instance()->weechat(), "fetchLines", Q_ARG(pointer_t, m_ptr), Q_ARG(int, m_lastRequestedCount));
     }
 }
 
 void Buffer::clearHotlist() {
-    input("/buffer set hotlist -1");
+    // switching back and forth between buffers shouldn't send the same command over and over,
+    // only once something new came in since the last time
+    const bool alreadyCleared = m_hotlistCleared && unreadMessagesGet() == 0 && hotMessagesGet() == 0;
     unreadMessagesSet(0);
     hotMessagesSet(0);
+    if (alreadyCleared || Lith::instance()->statusGet() != Lith::CONNECTED)
+        return;
+    // nothing waits for the result so there's no reason to block the GUI thread on the connection like input() does
+    QMetaObject::invokeMethod(Lith::instance()->weechat(), "input", Qt::QueuedConnection, Q_ARG(pointer_t, m_ptr), Q_ARG(QString, "/buffer set hotlist -1"));
+    m_hotlistCleared = true;
 }
 
 BufferLine::BufferLine(Buffer *parent)
     : QObject(parent)
 {
-    // connections to changed signals are required because FormattedString isn't directly connected to signals that can directly modify it
-    // having it here results in fewer connections and that means lower cpu load when the signals are fired
-    connect(Lith::instance()->settingsGet(), &Settings::shortenLongUrlsThresholdChanged, this, &BufferLine::messageChanged);
-    connect(Lith::instance()->settingsGet(), &Settings::shortenLongUrlsChanged, this, &BufferLine::messageChanged);
-    connect(Lith::instance()->windowHelperGet(), &WindowHelper::themeChanged, this, &BufferLine::messageChanged);
-    connect(Lith::instance()->windowHelperGet(), &WindowHelper::themeChanged, this, &BufferLine::prefixChanged);
+    // theme and URL shortening changes are not connected per line, delegates watch Lith::renderGeneration instead
 }
 
 BufferLine::~BufferLine() {
@@ -245,6 +781,28 @@ Lith *BufferLine::lith() {
     return nullptr;
 }
 
+QString BufferLine::timestampGet() {
+    if (!lith())
+        return QString();
+    return lith()->timestampFormatter()->format(m_date);
+}
+
+QStringList BufferLine::tags_arrayGet() const {
+    return m_tags.toStringList();
+}
+
+void BufferLine::tags_arraySet(const QStringList &o) {
+    TagSet tags(o);
+    if (m_tags != tags) {
+        m_tags = tags;
+        emit tags_arrayChanged();
+    }
+}
+
+const TagSet &BufferLine::tags() const {
+    return m_tags;
+}
+
 FormattedString BufferLine::prefixGet() const {
     return m_prefix;
 }
@@ -252,17 +810,18 @@ FormattedString BufferLine::prefixGet() const {
 void BufferLine::prefixSet(const FormattedString &o) {
     if (m_prefix != o) {
         m_prefix = o;
-        // TODO this is probably wrong
-        if (m_prefix.toPlain().startsWith("@") || m_prefix.toPlain().startsWith("+")) {
-            m_nick = m_prefix.toPlain().mid(1);
-        }
-        else {
-            m_nick = m_prefix.toPlain();
-        }
+        m_nick = nickFromPrefix(m_prefix.toPlain());
         emit prefixChanged();
     }
 }
 
+QString BufferLine::nickFromPrefix(const QString &prefix) {
+    // TODO this is probably wrong
+    if (prefix.startsWith("@") || prefix.startsWith("+"))
+        return prefix.mid(1);
+    return prefix;
+}
+
 QString BufferLine::nickGet() const {
     return m_nick;
 }
@@ -278,25 +837,25 @@ void BufferLine::messageSet(const FormattedString &o) {
     }
 }
 
-bool BufferLine::isSelfMsgGet() {
-    return m_tags_array.contains("self_msg");
+bool BufferLine::isSelfMsgGet() const {
+    return m_tags.contains(TagDictionary::SelfMsg);
 }
 
-bool BufferLine::isPrivMsgGet() {
-    return m_tags_array.contains("irc_privmsg");
+bool BufferLine::isPrivMsgGet() const {
+    return m_tags.contains(TagDictionary::IrcPrivmsg);
 }
 
-bool BufferLine::isJoinPartQuitMsgGet() {
-    return m_tags_array.contains("irc_quit") || m_tags_array.contains("irc_join") || m_tags_array.contains("irc_part");
+bool BufferLine::isJoinPartQuitMsgGet() const {
+    return m_tags.containsAny({ TagDictionary::IrcJoin, TagDictionary::IrcPart, TagDictionary::IrcQuit });
 }
 
-QString BufferLine::colorlessNicknameGet() {
+QString BufferLine::colorlessNicknameGet() const {
     return m_nick;
 }
 
-QString BufferLine::colorlessTextGet() {
-    auto messageStripped = QTextDocumentFragment::fromHtml(m_message).toPlainText();
-    return messageStripped;
+QString BufferLine::colorlessTextGet() const {
+    // FormattedString keeps the plain text in a single buffer, this doesn't copy anything
+    return m_message.toPlain();
 }
 
 QObject *BufferLine::bufferGet() {
@@ -312,6 +871,45 @@ Nick::Nick(Buffer *parent)
 Nick::~Nick() {
 }
 
+bool Nick::updateFrom(Nick &o) {
+    bool changed = m_visible != o.m_visible || m_group != o.m_group || m_level != o.m_level || m_name != o.m_name ||
+                   m_color != o.m_color || m_prefix != o.m_prefix || m_prefix_color != o.m_prefix_color || m_parentGroup != o.m_parentGroup;
+    m_parentGroup = o.m_parentGroup;
+    visibleSet(o.visibleGet());
+    groupSet(o.groupGet());
+    levelSet(o.levelGet());
+    nameSet(o.nameGet());
+    colorSet(o.colorGet());
+    prefixSet(o.prefixGet());
+    prefix_colorSet(o.prefix_colorGet());
+    return changed;
+}
+
+QString Nick::key() const {
+    // group is just a flag, the same name can be a group and a nick
+    return QString("%1|%2|%3").arg(int(m_group)).arg(m_parentGroup).arg(m_name.toPlain());
+}
+
+QString Nick::parentGroupGet() const {
+    return m_parentGroup;
+}
+
+void Nick::parentGroupSet(const QString &o) {
+    m_parentGroup = o;
+}
+
+void Nick::reset() {
+    m_visible = 0;
+    m_group = 0;
+    m_level = 0;
+    m_name.clear();
+    m_color.clear();
+    m_prefix.clear();
+    m_prefix_color.clear();
+    m_parentGroup.clear();
+    m_ptr = 0;
+}
+
 HotListItem::HotListItem(QObject *parent)
     : QObject(parent)
 {
@@ -332,7 +930,12 @@ void HotListItem::bufferSet(Buffer *o) {
 
 void HotListItem::onCountChanged() {
     if (bufferGet()) {
-        if (countGet().count() >= 3) {
+        // low, message, private and highlight
+        if (countGet().count() >= 4) {
+            bufferGet()->hotMessagesSet(countGet()[2] + countGet()[3]);
+            bufferGet()->unreadMessagesSet(countGet()[1]);
+        }
+        else if (countGet().count() >= 3) {
             bufferGet()->hotMessagesSet(countGet()[2]);
             bufferGet()->unreadMessagesSet(countGet()[1]);
         }
@@ -22,6 +22,12 @@
 #include "qmlobjectlist.h"
 #include "protocol.h"
 #include "util/messagelistfilter.h"
+#include "util/hdatabinding.h"
+#include "util/objectpool.h"
+#include "util/tagdictionary.h"
+#include "util/nickcompleter.h"
+#include "util/collapsedlinelist.h"
+#include "util/scrollbackcache.h"
 
 #include <QObject>
 #include <QDateTime>
@@ -51,6 +57,20 @@ public:
     Nick(Buffer *parent = nullptr);
     virtual ~Nick();
 
+    // puts the nick back to the default state before it's returned to ObjectPool
+    void reset();
+    // copies all the fields (except the pointer), returns true if anything changed
+    bool updateFrom(Nick &o);
+    // identifies the nick when its pointer isn't known
+    QString key() const;
+    // name of the group the nick is in, WeeChat only tells that by the order of the nicklist items
+    QString parentGroupGet() const;
+    void parentGroupSet(const QString &o);
+
+    static const HDataBinding<Nick> hdataBinding;
+
+private:
+    QString m_parentGroup {};
 };
 
 class Buffer : public QObject {
@@ -66,7 +86,9 @@ class Buffer : public QObject {
     PROPERTY(int, unreadMessages)
     PROPERTY(int, hotMessages)
 
-    Q_PROPERTY(MessageFilterList* lines_filtered READ lines_filtered CONSTANT)
+    // created when first asked for, released by releaseLineModels
+    Q_PROPERTY(MessageFilterList* lines_filtered READ lines_filtered NOTIFY lineModelsChanged)
+    Q_PROPERTY(CollapsedLineList* lines_collapsed READ lines_collapsed NOTIFY lineModelsChanged)
     Q_PROPERTY(QmlObjectList *lines READ lines CONSTANT)
     Q_PROPERTY(QmlObjectList *nicks READ nicks CONSTANT)
     Q_PROPERTY(int normals READ normalsGet NOTIFY nicksChanged)
@@ -79,25 +101,77 @@ public:
     Buffer(Lith *parent, pointer_t pointer);
     virtual ~Buffer();
 
+    static const HDataBinding<Buffer> hdataBinding;
+
     Lith *lith();
+    pointer_t ptrGet() const;
 
     //BufferLine *getLine(pointer_t ptr);
     void prependLine(BufferLine *line);
+    // lines are expected oldest first
+    void prependLines(const QList<BufferLine*> &lines);
     void appendLine(BufferLine *line);
+    void appendLines(const QList<BufferLine*> &lines);
 
     FormattedString titleGet() const;
     void titleSet(const FormattedString &o);
 
     bool isAfterInitialFetch();
+    // pointer to the oldest "line" (not line_data) received so far, used as a cursor for paging in history
+    void oldestLineSet(pointer_t ptr, const QDateTime &date);
+    void linesFetched(pointer_t oldestLinePtr, const QDateTime &oldestLineDate, int count, bool reachedCache = false);
+    pointer_t oldestLineGet() const;
+    QDateTime oldestLineDateGet() const;
+    // the relay may have trimmed the line by now, only page from it once the oldest lines of the buffer show it's still there
+    void fetchLinesBeforeOldest();
+    // the cursor can't be trusted anymore, the next page is counted from the end of the buffer instead
+    void resetOldestLine();
+
+    // starts storing the lines on disk, called once the buffer has its name
+    void openScrollback();
+    // loads the lines stored on disk from previous sessions, only once the buffer gets shown
+    void restoreScrollback();
+    // true if the line doesn't have to be fetched because it's already stored on disk
+    bool isCached(const QDateTime &date, const FormattedString &prefix, const FormattedString &message) const;
+    // the log has a gap, the restored lines are replaced by the history fetched from the relay
+    void dropCachedLines();
 
     QmlObjectList *lines();
     QmlObjectList *nicks();
     MessageFilterList *lines_filtered();
+    CollapsedLineList *lines_collapsed();
+    // drops the filtered line models until the buffer is shown again
+    void releaseLineModels();
     Q_INVOKABLE Nick *getNick(pointer_t ptr);
     void addNick(pointer_t ptr, Nick* nick);
+    // nicks are expected to have their ptr already set
+    void addNicks(const QList<Nick*> &nicks);
     void removeNick(pointer_t ptr);
     void clearNicks();
+    // applies a full nicklist snapshot, nicks already present are updated in place
+    void reconcileNicks(const QList<Nick*> &snapshot);
+    // new lines and nicklist diffs wait for the next frame and get into the models in batches
+    void queueLine(BufferLine *line);
+    // op is the _diff character, the nick is taken over (nullptr for removals)
+    void queueNickDiff(char op, pointer_t ptr, Nick *nick);
+    // applies everything queued, to be called by Lith once per frame
+    void flushPendingUpdates();
+    // lines of buffers that aren't shown are only kept serialized until Lith::materializeLines needs them,
+    // they go to the scrollback cache right away
+    void deferLine(const ScrollbackCache::Record &record);
+    QList<ScrollbackCache::Record> takeDeferredLines();
+    // the deferred lines without taking them
+    QList<ScrollbackCache::Record> deferredLines() const;
+    // a line of this buffer made from a stored or deferred record, not added anywhere yet
+    BufferLine *createLine(const ScrollbackCache::Record &record);
+    qint64 deferredBytes() const;
+    // of all buffers together
+    static qint64 totalDeferredBytes();
+    // counts a line the way WeeChat's hotlist would, until the next hotlist poll replaces the counters
+    void countUnreadLine(bool highlight, const QStringList &tags);
     Q_INVOKABLE QStringList getVisibleNicks();
+    // up to n visible nicks starting with the prefix (case insensitive), the ones who spoke last first
+    Q_INVOKABLE QStringList complete(const QString &prefix, int n = 10) const;
     int normalsGet() const;
     int voicesGet() const;
     int opsGet() const;
@@ -110,6 +184,7 @@ public:
 signals:
     void nicksChanged();
     void titleChanged();
+    void lineModelsChanged();
 
 public slots:
     bool input(const QString &data);
@@ -117,23 +192,61 @@ public slots:
     void clearHotlist();
 
 private:
+    inline static const int c_linesPerFetch { 25 };
+
     QmlObjectList *m_lines { nullptr };
     QmlObjectList *m_nicks { nullptr };
     MessageFilterList *m_proxyLinesFiltered { nullptr };
+    CollapsedLineList *m_linesCollapsed { nullptr };
     pointer_t m_ptr;
     bool m_afterInitialFetch { false };
     int m_lastRequestedCount { 0 };
+    pointer_t m_oldestLinePtr { 0 };
+    QDateTime m_oldestLineDate;
+    bool m_fetchInProgress { false };
+    bool m_historyComplete { false };
+    ScrollbackCache *m_scrollback { nullptr };
+    bool m_scrollbackRestored { false };
+    // the log doesn't continue where the relay history reached it, the relay is asked for everything
+    bool m_scrollbackGap { false };
+    // lines restored from m_scrollback, they're always at the end (the oldest part) of m_lines
+    int m_cachedLineCount { 0 };
+    NickCompleter m_nickCompleter {};
+    // the hotlist was cleared in WeeChat and no line came since
+    bool m_hotlistCleared { false };
+    struct NickDiff {
+        char op;
+        pointer_t ptr;
+        Nick *nick;
+    };
+    // waiting for the next frame, in the order they arrived
+    QList<BufferLine*> m_pendingLines {};
+    QList<NickDiff> m_pendingNickDiffs {};
+    // serialized ScrollbackCache records, oldest first
+    QList<QByteArray> m_deferredLines {};
+    qint64 m_deferredBytes { 0 };
+    static qint64 s_totalDeferredBytes;
+
+    void applyNickDiffs(const QList<NickDiff> &diffs);
+    void storeLine(BufferLine *line);
+    // the author of a message counts as active for nick completion
+    void noteActivity(BufferLine *line);
+    // starts laying out the count rows from first in the background if they're about to be shown
+    void prepareLayouts(int first, int count);
     FormattedString m_title {};
 };
 
 class BufferLine : public QObject {
     Q_OBJECT
+    PROPERTY(pointer_t, ptr)
     PROPERTY(QDateTime, date)
     PROPERTY(bool, displayed)
     PROPERTY(bool, highlight)
-    PROPERTY(QStringList, tags_array)
+    Q_PROPERTY(QStringList tags_array READ tags_arrayGet WRITE tags_arraySet NOTIFY tags_arrayChanged)
 
     Q_PROPERTY(QString nick READ nickGet NOTIFY prefixChanged)
+    // date formatted by Lith::timestampFormatter, doesn't notify about format changes, see Lith::renderGeneration
+    Q_PROPERTY(QString timestamp READ timestampGet NOTIFY dateChanged)
     Q_PROPERTY(FormattedString prefix READ prefixGet WRITE prefixSet NOTIFY prefixChanged)
     Q_PROPERTY(FormattedString message READ messageGet WRITE messageSet NOTIFY messageChanged)
 
@@ -147,28 +260,37 @@ public:
     BufferLine(Buffer *parent);
     virtual ~BufferLine();
 
+    static const HDataBinding<BufferLine> hdataBinding;
+
     Buffer *buffer();
     Lith *lith();
 
     void setParent(Buffer *parent);
 
+    QString timestampGet();
+    QStringList tags_arrayGet() const;
+    void tags_arraySet(const QStringList &o);
+    const TagSet &tags() const;
     FormattedString prefixGet() const;
     void prefixSet(const FormattedString &o);
     QString nickGet() const;
+    // the nick of a message with the prefix, without the mode character
+    static QString nickFromPrefix(const QString &prefix);
     FormattedString messageGet() const;
     void messageSet(const FormattedString &o);
 
-    bool isJoinPartQuitMsgGet();
-    bool isPrivMsgGet();
-    bool isSelfMsgGet();
-    QString colorlessNicknameGet();
-    QString colorlessTextGet();
+    bool isJoinPartQuitMsgGet() const;
+    bool isPrivMsgGet() const;
+    bool isSelfMsgGet() const;
+    QString colorlessNicknameGet() const;
+    QString colorlessTextGet() const;
 
     QObject *bufferGet();
 
     QList<QObject*> segments();
 
 signals:
+    void tags_arrayChanged();
     void segmentsChanged();
     void messageChanged();
     void prefixChanged();
@@ -179,6 +301,7 @@ private:
     FormattedString m_message;
     FormattedString m_prefix;
     QString m_nick;
+    TagSet m_tags;
 };
 
 class HotListItem : public QObject {
@@ -188,6 +311,8 @@ class HotListItem : public QObject {
 public:
     HotListItem(QObject *parent = nullptr);
 
+    static const HDataBinding<HotListItem> hdataBinding;
+
     Buffer *bufferGet();
     void bufferSet(Buffer *o);
 
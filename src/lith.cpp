@@ -20,8 +20,11 @@
 #include "datamodel.h"
 #include "weechat.h"
 #include "windowhelper.h"
+#include "util/searchindex.h"
 
+#include <algorithm>
 #include <iostream>
+#include <utility>
 #include <QThread>
 #include <QEventLoop>
 #include <QAbstractEventDispatcher>
@@ -30,6 +33,9 @@
 
 #include <QUrl>
 
+// serialized lines kept for all background buffers together before the largest queues get turned into BufferLines anyway
+static const qint64 c_deferredLinesBudget = 2 * 1024 * 1024;
+
 Lith *Lith::_self = nullptr;
 Lith *Lith::instance() {
     if (!_self)
@@ -69,6 +75,13 @@ int Lith::selectedBufferIndex() {
 void Lith::selectedBufferIndexSet(int index) {
     if (m_selectedBufferIndex != index && index < m_buffers->count()) {
         m_selectedBufferIndex = index;
+        // the lines that came while the buffer was in the background are shown right away
+        if (selectedBuffer()) {
+            materializeLines(selectedBuffer());
+            selectedBuffer()->flushPendingUpdates();
+            // after those, the lines already in the buffer aren't restored twice
+            selectedBuffer()->restoreScrollback();
+        }
         emit selectedBufferChanged();
         if (selectedBuffer()) {
             selectedBuffer()->fetchMoreLines();
@@ -76,6 +89,8 @@ void Lith::selectedBufferIndexSet(int index) {
         }
         if (index >= 0)
             settingsGet()->lastOpenBufferSet(index);
+        if (selectedBuffer() && selectedBuffer()->ptrGet())
+            settingsGet()->lastOpenBufferNameSet(selectedBuffer()->nameGet().toPlain());
     }
 }
 
@@ -93,6 +108,90 @@ void Lith::switchToBufferNumber(int number) {
     }
 }
 
+SearchIndex *Lith::searchIndex() {
+    return m_searchIndex;
+}
+
+TimestampFormatter *Lith::timestampFormatter() {
+    return &m_timestampFormatter;
+}
+
+QList<QObject*> Lith::search(const QString &query, int limit) {
+    // the lines made for the previous results go away, deleteLater lets QML drop them first
+    for (auto &i : m_searchResultLines) {
+        if (i)
+            i->deleteLater();
+    }
+    m_searchResultLines.clear();
+
+    struct Result {
+        int score;
+        QDateTime date;
+        BufferLine *line;
+        // the deferred lines aren't in the index, they stay serialized in their buffers unless they match
+        Buffer *buffer;
+        ScrollbackCache::Record record;
+    };
+    QList<Result> results;
+    for (auto &i : m_searchIndex->query(query, limit))
+        results.append({ i.score, i.line->dateGet(), i.line, nullptr, {} });
+    const auto words = SearchIndex::parseQuery(query);
+    for (int i = 0; i < m_buffers->count() && !words.isEmpty(); i++) {
+        auto buffer = m_buffers->get<Buffer>(i);
+        if (!buffer || buffer->deferredBytes() == 0)
+            continue;
+        for (auto &record : buffer->deferredLines()) {
+            auto terms = SearchIndex::terms(record.message, BufferLine::nickFromPrefix(record.prefix.toPlain()), record.tags);
+            const int score = SearchIndex::score(words, terms);
+            if (score > 0)
+                results.append({ score, record.date, nullptr, buffer, record });
+        }
+    }
+    std::stable_sort(results.begin(), results.end(), [](const Result &a, const Result &b) {
+        if (a.score != b.score)
+            return a.score > b.score;
+        return a.date > b.date;
+    });
+    if (limit > 0 && results.count() > limit)
+        results.resize(limit);
+
+    QList<QObject*> result;
+    for (auto &i : results) {
+        auto line = i.line;
+        if (!line) {
+            line = i.buffer->createLine(i.record);
+            m_searchResultLines.append(line);
+        }
+        result.append(line);
+    }
+    return result;
+}
+
+QVariantMap Lith::allocationStatistics() {
+    return {
+        { "nicks", ObjectPool<Nick>::instance().statisticsMap() }
+    };
+}
+
+QVariantMap Lith::ingestStatistics() {
+    return m_frameScheduler->statisticsMap();
+}
+
+QVariantMap Lith::bindingStatistics() {
+    return {
+        { "buffers", HDataBinding<Buffer>::unknownKeyCount() },
+        { "lines", HDataBinding<BufferLine>::unknownKeyCount() },
+        { "nicks", HDataBinding<Nick>::unknownKeyCount() },
+        { "hotlist", HDataBinding<HotListItem>::unknownKeyCount() }
+    };
+}
+
+void Lith::scheduleUpdate(Buffer *buffer) {
+    if (!m_buffersWithPendingUpdates.contains(buffer))
+        m_buffersWithPendingUpdates.append(buffer);
+    m_frameScheduler->request();
+}
+
 QString Lith::getLinkFileExtension(const QString &url) {
     QUrl u(url);
     auto extension = u.fileName().split(".").last().toLower();
@@ -133,10 +232,26 @@ Lith::Lith(QObject *parent)
     , m_buffers(QmlObjectList::create<Buffer>())
     , m_proxyBufferList(new ProxyBufferList(this, m_buffers))
     , m_selectedBufferNicks(new NickListFilter(this))
+    , m_searchIndex(new SearchIndex(this))
+    , m_frameScheduler(new FrameScheduler(this))
 {
+    connect(m_frameScheduler, &FrameScheduler::frame, this, &Lith::flushPendingUpdates);
 
     connect(settingsGet(), &Settings::passphraseChanged, this, &Lith::hasPassphraseChanged);
+    auto bumpRenderGeneration = [this]() {
+        m_renderGeneration++;
+        emit renderGenerationChanged();
+    };
+    connect(settingsGet(), &Settings::shortenLongUrlsThresholdChanged, this, bumpRenderGeneration);
+    connect(settingsGet(), &Settings::shortenLongUrlsChanged, this, bumpRenderGeneration);
+    connect(windowHelperGet(), &WindowHelper::themeChanged, this, bumpRenderGeneration);
+    m_timestampFormatter.setFormat(settingsGet()->timestampFormatGet());
+    connect(settingsGet(), &Settings::timestampFormatChanged, this, [this, bumpRenderGeneration]() {
+        m_timestampFormatter.setFormat(settingsGet()->timestampFormatGet());
+        bumpRenderGeneration();
+    });
     connect(this, &Lith::selectedBufferChanged, [this](){
+        retainLineModels(selectedBuffer());
         if (selectedBuffer())
             m_selectedBufferNicks->setSourceModel(selectedBuffer()->nicks());
         else
@@ -146,6 +261,8 @@ Lith::Lith(QObject *parent)
     m_weechat->moveToThread(m_weechatThread);
     m_weechatThread->start();
 #endif
+    // once Lith::instance() is there for the buffer, still well before the relay answers
+    QTimer::singleShot(0, this, &Lith::restoreLastOpenBuffer);
     QTimer::singleShot(1, m_weechat, &Weechat::init);
 }
 
@@ -162,23 +279,37 @@ void Lith::resetData() {
     m_hotList.clear();
 }
 
+void Lith::restoreLastOpenBuffer() {
+    auto name = settingsGet()->lastOpenBufferNameGet();
+    if (!settingsGet()->scrollbackCacheGet() || name.isEmpty())
+        return;
+    // a stand-in without a pointer, it goes away with resetData once the relay sends the real buffers
+    auto buffer = new Buffer(this, 0);
+    buffer->nameSet(name);
+    m_buffers->append(buffer);
+    // not through selectedBufferIndexSet, the relay isn't there to fetch lines from and the setting stays
+    m_selectedBufferIndex = 0;
+    buffer->restoreScrollback();
+    emit selectedBufferChanged();
+}
+
 void Lith::reconnect() {
     m_weechat->restart();
 }
 
 void Lith::handleBufferInitialization(const Protocol::HData &hda) {
+    auto bindings = Buffer::hdataBinding.resolve(hda);
     for (auto &i : hda.data) {
         // buffer
         auto ptr = i.pointers.first();
         auto b = new Buffer(this, ptr);
-        for (auto j : i.objects.keys()) {
-            b->setProperty(qPrintable(j), i.objects[j]);
-        }
+        bindings.apply(b, i);
         addBuffer(ptr, b);
     }
 }
 
 void Lith::handleFirstReceivedLine(const Protocol::HData &hda) {
+    auto bindings = BufferLine::hdataBinding.resolve(hda);
     for (auto &i : hda.data) {
         // buffer - lines - line - line_data
         auto bufPtr = i.pointers.first();
@@ -191,17 +322,22 @@ void Lith::handleFirstReceivedLine(const Protocol::HData &hda) {
         auto line = getLine(bufPtr, linePtr);
         if (line)
             continue;
-        line = new BufferLine(buffer);
-        for (auto j : i.objects.keys()) {
-            if (j != "buffer")
-                line->setProperty(qPrintable(j), i.objects[j]);
+        if (buffer->isCached(i.objects["date"].toDateTime(), qvariant_cast<FormattedString>(i.objects["prefix"]), qvariant_cast<FormattedString>(i.objects["message"]))) {
+            // nothing new since the last time, paging from this line finds out whether the log has the rest
+            buffer->oldestLineSet(i.pointers[i.pointers.count() - 2], i.objects["date"].toDateTime());
+            continue;
         }
-        buffer->appendLine(line);
+        line = new BufferLine(buffer);
+        bindings.apply(line, i);
         addLine(bufPtr, linePtr, line);
+        buffer->appendLine(line);
+        // older history gets paged in starting from this line
+        buffer->oldestLineSet(i.pointers[i.pointers.count() - 2], line->dateGet());
     }
 }
 
 void Lith::handleHotlistInitialization(const Protocol::HData &hda) {
+    auto bindings = HotListItem::hdataBinding.resolve(hda);
     for (auto &i : hda.data) {
         // hotlist
         auto ptr = i.pointers.first();
@@ -211,16 +347,17 @@ void Lith::handleHotlistInitialization(const Protocol::HData &hda) {
         if (buffer) {
             item->bufferSet(buffer);
         }
-        for (auto j : i.objects.keys()) {
-            if (j == "buffer")
-                continue;
-            item->setProperty(qPrintable(j), i.objects[j]);
-        }
+        bindings.apply(item, i);
         addHotlist(ptr, item);
     }
 }
 
 void Lith::handleNicklistInitialization(const Protocol::HData &hda) {
+    auto bindings = Nick::hdataBinding.resolve(hda);
+    // nicks come grouped by buffer, insert each group into the model at once
+    Buffer *previousBuffer = nullptr;
+    QString parentGroup;
+    QList<Nick*> batch;
     for (auto &i : hda.data) {
         // buffer - nicklist_item
         auto bufPtr = i.pointers.first();
@@ -230,38 +367,112 @@ void Lith::handleNicklistInitialization(const Protocol::HData &hda) {
             qWarning() << "Nick missing a parent:";
             continue;
         }
-        auto nick = new Nick(buffer);
-        for (auto j : i.objects.keys()) {
-            nick->setProperty(qPrintable(j), i.objects[j]);
+        if (buffer != previousBuffer && previousBuffer) {
+            previousBuffer->addNicks(batch);
+            batch.clear();
         }
-        buffer->addNick(nickPtr, nick);
+        if (buffer != previousBuffer)
+            parentGroup.clear();
+        previousBuffer = buffer;
+        // goes straight to the model, there's nothing to reuse it for afterwards
+        auto nick = new Nick(buffer);
+        bindings.apply(nick, i);
+        nick->ptrSet(nickPtr);
+        nick->parentGroupSet(parentGroup);
+        // the items of a group follow right after it
+        if (nick->groupGet())
+            parentGroup = nick->nameGet().toPlain();
+        batch.append(nick);
     }
+    if (previousBuffer)
+        previousBuffer->addNicks(batch);
 }
 
-void Lith::handleFetchLines(const Protocol::HData &hda) {
-    for (auto &i : hda.data) {
-        // buffer - lines - line - line_data
-        auto bufPtr = i.pointers.first();
+void Lith::handleFetchLines(const Protocol::HData &hda, pointer_t bufPtr) {
+    auto bindings = BufferLine::hdataBinding.resolve(hda);
+    auto buffer = getBuffer(bufPtr);
+    if (!buffer) {
+        qWarning() << "Fetched lines for nonexistent buffer" << QString("%1").arg(bufPtr, 16, 16, QChar('0'));
+        return;
+    }
+    // the fetched lines may overlap with the deferred ones, those have to be known by their pointers first
+    materializeLines(buffer);
+    // all lines end up in the model in a single insertion
+    QList<BufferLine*> batch;
+    pointer_t oldestLinePtr = 0;
+    QDateTime oldestLineDate;
+    bool reachedCache = false;
+    auto isCached = [buffer](const Protocol::HData::Item &i) {
+        return buffer->isCached(i.objects["date"].toDateTime(), qvariant_cast<FormattedString>(i.objects["prefix"]), qvariant_cast<FormattedString>(i.objects["message"]));
+    };
+    for (int n = 0; n < hda.data.count(); n++) {
+        auto &i = hda.data[n];
+        // buffer - lines - line - line_data or line - line_data when paging from an already known line
         auto linePtr = i.pointers.last();
-        auto buffer = getBuffer(bufPtr);
-        if (!buffer) {
-            qWarning() << "Line missing a parent:";
-            continue;
+        if (i.pointers.count() >= 2) {
+            oldestLinePtr = i.pointers[i.pointers.count() - 2];
+            oldestLineDate = i.objects["date"].toDateTime();
         }
         auto line = getLine(bufPtr, linePtr);
         if (line)
             continue;
-        line = new BufferLine(buffer);
-        for (auto j : i.objects.keys()) {
-            if (j != "buffer")
-                line->setProperty(qPrintable(j), i.objects[j]);
+        // lines come newest first, the log only replaces the rest of the history if it has the older lines too
+        if (isCached(i)) {
+            if (n == hda.data.count() - 1) {
+                // nothing to compare with, the next page starts from this line again
+                break;
+            }
+            if (std::all_of(hda.data.begin() + n + 1, hda.data.end(), isCached)) {
+                reachedCache = true;
+                break;
+            }
+            buffer->dropCachedLines();
         }
-        buffer->appendLine(line);
+        line = new BufferLine(buffer);
+        bindings.apply(line, i);
+        batch.append(line);
         addLine(bufPtr, linePtr, line);
     }
+    buffer->appendLines(batch);
+    buffer->linesFetched(oldestLinePtr, oldestLineDate, hda.data.count(), reachedCache);
+}
+
+void Lith::handleOldestLines(const Protocol::HData &hda, pointer_t bufPtr) {
+    auto buffer = getBuffer(bufPtr);
+    if (!buffer) {
+        qWarning() << "Fetched lines for nonexistent buffer" << QString("%1").arg(bufPtr, 16, 16, QChar('0'));
+        return;
+    }
+    // buffer - lines - line - line_data, oldest first
+    const auto cursor = buffer->oldestLineGet();
+    const auto cursorDate = buffer->oldestLineDateGet();
+    for (int n = 0; n < hda.data.count(); n++) {
+        auto &i = hda.data[n];
+        if (i.pointers.count() < 2 || i.pointers[i.pointers.count() - 2] != cursor)
+            continue;
+        // the rest of the history fits in this reply, it's handled like any other page (newest first)
+        Protocol::HData older { hda.keys, hda.path, {} };
+        for (int j = n - 1; j >= 0; j--)
+            older.data.append(hda.data[j]);
+        handleFetchLines(older, bufPtr);
+        return;
+    }
+    if (!hda.data.isEmpty() && hda.data.last().objects["date"].toDateTime() < cursorDate) {
+        // there are enough lines before the cursor that it can't have been trimmed yet
+        buffer->fetchLinesBeforeOldest();
+    }
+    else if (!hda.data.isEmpty() && hda.data.first().objects["date"].toDateTime() > cursorDate) {
+        // lines are trimmed from the start, everything before the cursor is gone together with it
+        buffer->linesFetched(0, QDateTime(), 0);
+    }
+    else {
+        // can't tell from the dates alone, counting lines from the end is always safe
+        buffer->resetOldestLine();
+    }
 }
 
 void Lith::handleHotlist(const Protocol::HData &hda) {
+    auto bindings = HotListItem::hdataBinding.resolve(hda);
     for (auto &i : hda.data) {
         // hotlist
         auto hlPtr = i.pointers.first();
@@ -276,15 +487,12 @@ void Lith::handleHotlist(const Protocol::HData &hda) {
             hl = new HotListItem(this);
             hl->bufferSet(buf);
         }
-        for (auto j : i.objects.keys()) {
-            if (j == "buffer")
-                continue;
-            hl->setProperty(qPrintable(j), i.objects[j]);
-        }
+        bindings.apply(hl, i);
     }
 }
 
 void Lith::_buffer_opened(const Protocol::HData &hda) {
+    auto bindings = Buffer::hdataBinding.resolve(hda);
     for (auto &i : hda.data) {
         // buffer
         auto bufPtr = i.pointers.first();
@@ -292,9 +500,7 @@ void Lith::_buffer_opened(const Protocol::HData &hda) {
         if (buffer)
             continue;
         buffer = new Buffer(this, bufPtr);
-        for (auto j : i.objects.keys()) {
-            buffer->setProperty(qPrintable(j), i.objects[j]);
-        }
+        bindings.apply(buffer, i);
         addBuffer(bufPtr, buffer);
     }
 }
@@ -330,9 +536,9 @@ void Lith::_buffer_renamed(const Protocol::HData &hda) {
         auto buf = getBuffer(bufPtr);
         if (!buf)
             continue;
-        for (auto j : i.objects.keys()) {
-            if (j.endsWith("name")) {
-                buf->setProperty(qPrintable(j), i.objects[j]);
+        for (auto it = i.objects.cbegin(); it != i.objects.cend(); ++it) {
+            if (it.key().endsWith("name")) {
+                Buffer::hdataBinding.applyOne(buf, it.key(), it.value());
             }
         }
     }
@@ -385,11 +591,18 @@ void Lith::_buffer_closing(const Protocol::HData &hda) {
 }
 
 void Lith::_buffer_cleared(const Protocol::HData &hda) {
+    // the lines we'd page from are freed on the relay
+    for (auto &i : hda.data) {
+        auto buffer = getBuffer(i.pointers.first());
+        if (buffer)
+            buffer->resetOldestLine();
+    }
     qCritical() << __FUNCTION__ << "is not implemented yet";
     std::cerr << hda.toString().toStdString() << std::endl;
 }
 
 void Lith::_buffer_line_added(const Protocol::HData &hda) {
+    auto bindings = BufferLine::hdataBinding.resolve(hda);
     for (auto &i : hda.data) {
         // line_data
         auto linePtr = i.pointers.last();
@@ -404,14 +617,33 @@ void Lith::_buffer_line_added(const Protocol::HData &hda) {
         if (line) {
             continue;
         }
-        line = new BufferLine(buffer);
-        for (auto j : i.objects.keys()) {
-            if (j == "buffer")
+        const bool highlight = qvariant_cast<bool>(i.objects["highlight"]);
+        if (buffer != selectedBuffer()) {
+            const auto tags = qvariant_cast<QStringList>(i.objects["tags_array"]);
+            buffer->countUnreadLine(highlight, tags);
+            // nobody's looking, only keep the line around serialized, notifications need the whole line though
+            if (!highlight && !buffer->isPrivateGet()) {
+                buffer->deferLine({
+                    qvariant_cast<QDateTime>(i.objects["date"]),
+                    linePtr,
+                    qvariant_cast<bool>(i.objects["displayed"]),
+                    highlight,
+                    tags,
+                    qvariant_cast<FormattedString>(i.objects["prefix"]),
+                    qvariant_cast<FormattedString>(i.objects["message"])
+                });
+                if (Buffer::totalDeferredBytes() > c_deferredLinesBudget)
+                    enforceDeferredLinesBudget();
                 continue;
-            line->setProperty(qPrintable(j), i.objects[j]);
+            }
         }
-        buffer->prependLine(line);
+        // the deferred lines are older, they have to get into the model first
+        materializeLines(buffer);
+        line = new BufferLine(buffer);
+        bindings.apply(line, i);
         addLine(bufPtr, linePtr, line);
+        // floods would otherwise insert and relayout line by line
+        buffer->queueLine(line);
         if (line->highlightGet() || (buffer->isPrivateGet() && line->isPrivMsgGet() && !line->isSelfMsgGet())) {
             static QIcon appIcon(":/icon.png");
             static QSystemTrayIcon *icon = new QSystemTrayIcon(appIcon);
@@ -429,7 +661,10 @@ void Lith::_buffer_line_added(const Protocol::HData &hda) {
 }
 
 void Lith::_nicklist(const Protocol::HData &hda) {
+    auto bindings = Nick::hdataBinding.resolve(hda);
     Buffer *previousBuffer = nullptr;
+    QString parentGroup;
+    QList<Nick*> batch;
     for (auto &i : hda.data) {
         // buffer - nicklist_item
         auto bufPtr = i.pointers.first();
@@ -437,18 +672,31 @@ void Lith::_nicklist(const Protocol::HData &hda) {
         auto buffer = getBuffer(bufPtr);
         if (!buffer)
             continue;
-        if (buffer != previousBuffer)
-            buffer->clearNicks();
-        previousBuffer = buffer;
-        auto nick = new Nick(buffer);
-        for (auto j : i.objects.keys()) {
-            nick->setProperty(qPrintable(j), i.objects[j]);
+        if (buffer != previousBuffer && previousBuffer) {
+            previousBuffer->reconcileNicks(batch);
+            batch.clear();
         }
-        buffer->addNick(nickPtr, nick);
+        // diffs that came before the snapshot mustn't be applied over it
+        if (buffer != previousBuffer) {
+            buffer->flushPendingUpdates();
+            parentGroup.clear();
+        }
+        previousBuffer = buffer;
+        auto nick = ObjectPool<Nick>::instance().acquire(buffer);
+        bindings.apply(nick, i);
+        nick->ptrSet(nickPtr);
+        nick->parentGroupSet(parentGroup);
+        if (nick->groupGet())
+            parentGroup = nick->nameGet().toPlain();
+        batch.append(nick);
     }
+    if (previousBuffer)
+        previousBuffer->reconcileNicks(batch);
 }
 
 void Lith::_nicklist_diff(const Protocol::HData &hda) {
+    auto bindings = Nick::hdataBinding.resolve(hda);
+    QString parentGroup;
     for (auto &i : hda.data) {
         // buffer - nicklist_item
         auto bufPtr = i.pointers.first();
@@ -458,30 +706,22 @@ void Lith::_nicklist_diff(const Protocol::HData &hda) {
             continue;
         auto op = qvariant_cast<char>(i.objects["_diff"]);
         switch (op) {
-        case '+': {
-            auto nick = new Nick(buffer);
-            for (auto j : i.objects.keys()) {
-                if (j == "_diff")
-                    continue;
-                nick->setProperty(qPrintable(j), i.objects[j]);
-            }
-            buffer->addNick(nickPtr, nick);
+        case '^': {
+            // not a change, the group the following items belong to
+            parentGroup = qvariant_cast<FormattedString>(i.objects["name"]).toPlain();
             break;
         }
-        case '-': {
-            buffer->removeNick(nickPtr);
+        case '+':
+        case '*': {
+            // changed nicks come whole, they're copied over the existing ones once the diff is applied
+            auto nick = ObjectPool<Nick>::instance().acquire(buffer);
+            bindings.apply(nick, i);
+            nick->parentGroupSet(parentGroup);
+            buffer->queueNickDiff(op, nickPtr, nick);
             break;
         }
-        case '^':
-        case '*': {
-            auto nick = buffer->getNick(nickPtr);
-            if (!nick)
-                break;
-            for (auto j : i.objects.keys()) {
-                if (j == "_diff")
-                    continue;
-                nick->setProperty(qPrintable(j), i.objects[j]);
-            }
+        case '-': {
+            buffer->queueNickDiff(op, nickPtr, nullptr);
             break;
         }
         default:
@@ -491,12 +731,23 @@ void Lith::_nicklist_diff(const Protocol::HData &hda) {
     }
 }
 
+void Lith::flushPendingUpdates() {
+    // buffers closed in the meantime dropped their queues already
+    const auto buffers = std::exchange(m_buffersWithPendingUpdates, {});
+    for (auto &buffer : buffers) {
+        if (buffer)
+            buffer->flushPendingUpdates();
+    }
+}
+
 void Lith::_pong(const FormattedString &str) {
     emit pongReceived(str.toLongLong());
 }
 
 void Lith::addBuffer(pointer_t ptr, Buffer *b) {
     m_bufferMap[ptr] = b;
+    // the stored lines are only read once the buffer gets shown
+    b->openScrollback();
     m_buffers->append(b);
     auto lastOpenBuffer = settingsGet()->lastOpenBufferGet();
     if (m_buffers->count() == 1 && lastOpenBuffer < 0)
@@ -512,6 +763,13 @@ void Lith::removeBuffer(pointer_t ptr) {
         if (selectedBuffer() == buf)
             selectedBufferIndexSet(selectedBufferIndex() - 1);
         m_bufferMap.remove(ptr);
+        // lines of the buffer are going away with it, they mustn't stay reachable through their pointers
+        for (auto it = m_lineMap.begin(); it != m_lineMap.end(); ) {
+            if (it.value().isNull() || it.value()->buffer() == buf)
+                it = m_lineMap.erase(it);
+            else
+                ++it;
+        }
         m_buffers->removeItem(buf);
     }
 }
@@ -522,6 +780,43 @@ Buffer *Lith::getBuffer(pointer_t ptr) {
     return nullptr;
 }
 
+void Lith::retainLineModels(Buffer *buffer) {
+    // switching between a handful of buffers doesn't build their models again
+    static const int c_retainedLineModels = 8;
+    m_buffersWithLineModels.removeIf([](const QPointer<Buffer> &i) { return i.isNull(); });
+    if (buffer) {
+        m_buffersWithLineModels.removeAll(buffer);
+        m_buffersWithLineModels.prepend(buffer);
+    }
+    while (m_buffersWithLineModels.count() > c_retainedLineModels) {
+        auto released = m_buffersWithLineModels.takeLast();
+        if (released)
+            released->releaseLineModels();
+    }
+}
+
+void Lith::materializeLines(Buffer *buffer) {
+    for (auto &i : buffer->takeDeferredLines()) {
+        auto line = buffer->createLine(i);
+        addLine(buffer->ptrGet(), i.ptr, line);
+        buffer->queueLine(line);
+    }
+}
+
+void Lith::enforceDeferredLinesBudget() {
+    while (Buffer::totalDeferredBytes() > c_deferredLinesBudget) {
+        Buffer *largest = nullptr;
+        for (int i = 0; i < m_buffers->count(); i++) {
+            auto buffer = m_buffers->get<Buffer>(i);
+            if (buffer && (!largest || buffer->deferredBytes() > largest->deferredBytes()))
+                largest = buffer;
+        }
+        if (!largest || largest->deferredBytes() == 0)
+            break;
+        materializeLines(largest);
+    }
+}
+
 void Lith::addLine(pointer_t bufPtr, pointer_t linePtr, BufferLine *line) {
     auto ptr = bufPtr << 32 | linePtr;
     if (m_lineMap.contains(ptr)) {
@@ -531,6 +826,7 @@ void Lith::addLine(pointer_t bufPtr, pointer_t linePtr, BufferLine *line) {
         qCritical() << "New:" << line->messageGet();
     }
     m_lineMap[ptr] = line;
+    line->ptrSet(linePtr);
 }
 
 BufferLine *Lith::getLine(pointer_t bufPtr, pointer_t linePtr) {
@@ -559,19 +855,164 @@ HotListItem *Lith::getHotlist(pointer_t ptr) {
 ProxyBufferList::ProxyBufferList(QObject *parent, QAbstractListModel *parentModel)
     : QSortFilterProxyModel(parent)
 {
+    if (parentModel) {
+        // connected before setSourceModel does the same, the entries have to be there by the time new rows get filtered
+        connect(parentModel, &QAbstractItemModel::rowsInserted, this, &ProxyBufferList::onRowsInserted);
+        connect(parentModel, &QAbstractItemModel::modelReset, this, &ProxyBufferList::onModelReset);
+    }
     setSourceModel(parentModel);
-    setFilterRole(Qt::UserRole);
-    connect(this, &ProxyBufferList::filterWordChanged, [this] {
-        setFilterFixedString(filterWordGet());
-    });
+    onModelReset();
+    connect(this, &ProxyBufferList::filterWordChanged, this, &ProxyBufferList::onFilterWordChanged);
+    sort(0);
 }
+
 bool ProxyBufferList::filterAcceptsRow(int source_row, const QModelIndex &source_parent) const {
-    auto index = sourceModel()->index(source_row, 0, source_parent);
-    auto v = sourceModel()->data(index);
-    auto b = qvariant_cast<Buffer*>(v);
+    auto b = bufferAt(sourceModel()->index(source_row, 0, source_parent));
     if (b) {
-        return b->nameGet().toLower().contains(filterWordGet().toLower());
+        return scoreOf(b) >= 0;
     }
     return false;
 }
 
+bool ProxyBufferList::lessThan(const QModelIndex &source_left, const QModelIndex &source_right) const {
+    // without a filter word the buffers stay in their original order
+    if (!m_foldedFilter.isEmpty()) {
+        auto l = bufferAt(source_left);
+        auto r = bufferAt(source_right);
+        if (l && r) {
+            const int leftScore = scoreOf(l);
+            const int rightScore = scoreOf(r);
+            if (leftScore != rightScore)
+                return leftScore > rightScore;
+        }
+    }
+    return source_left.row() < source_right.row();
+}
+
+int ProxyBufferList::fuzzyScore(QStringView query, QStringView name) {
+    // roughly the fzf v1 algorithm and its constants
+    static const int c_scoreMatch = 16;
+    static const int c_penaltyGapStart = -3;
+    static const int c_penaltyGapExtension = -1;
+    static const int c_bonusBoundary = 8;
+    static const int c_bonusConsecutive = 4;
+
+    if (query.isEmpty())
+        return 0;
+
+    // the first occurrence of the whole query, the characters are found with the vectorized indexOf
+    qsizetype end = -1;
+    for (auto c : query) {
+        end = name.indexOf(c, end + 1);
+        if (end < 0)
+            return -1;
+    }
+    // going back from its end gives the shortest window with the query in it
+    qsizetype start = end + 1;
+    for (auto q = query.size() - 1; q >= 0; q--)
+        start = name.lastIndexOf(query[q], start - 1);
+
+    int score = 0;
+    int consecutive = 0;
+    bool inGap = false;
+    qsizetype q = 0;
+    for (auto i = start; i <= end && q < query.size(); i++) {
+        if (name[i] != query[q]) {
+            score += inGap ? c_penaltyGapExtension : c_penaltyGapStart;
+            inGap = true;
+            consecutive = 0;
+            continue;
+        }
+        // the beginning of a word, like after '#' or '.' in a buffer name
+        int bonus = (i == 0 || !name[i - 1].isLetterOrNumber()) ? c_bonusBoundary : 0;
+        if (consecutive > 0)
+            bonus = qMax(bonus, c_bonusConsecutive);
+        if (q == 0)
+            bonus *= 2;
+        score += c_scoreMatch + bonus;
+        inGap = false;
+        consecutive++;
+        q++;
+    }
+    return qMax(score, 0);
+}
+
+void ProxyBufferList::onFilterWordChanged() {
+    auto folded = filterWordGet().toCaseFolded();
+    if (folded == m_foldedFilter)
+        return;
+    // a longer query can't match anything the shorter one didn't
+    const bool refining = !m_foldedFilter.isEmpty() && folded.startsWith(m_foldedFilter);
+    m_foldedFilter = folded;
+    for (auto &i : m_entries) {
+        if (refining && i.score < 0)
+            continue;
+        i.score = fuzzyScore(m_foldedFilter, i.folded);
+    }
+    if (refining) {
+        // rows can only go away, the ones still shown get sorted by their new scores without rebuilding the mapping
+        invalidateFilter();
+        setDynamicSortFilter(true);
+    }
+    else {
+        invalidate();
+    }
+}
+
+void ProxyBufferList::onRowsInserted(const QModelIndex &parent, int first, int last) {
+    for (int i = first; i <= last; i++) {
+        auto buffer = bufferAt(sourceModel()->index(i, 0, parent));
+        if (buffer)
+            addEntry(buffer);
+    }
+}
+
+void ProxyBufferList::onModelReset() {
+    if (!sourceModel())
+        return;
+    for (int i = 0; i < sourceModel()->rowCount(); i++) {
+        auto buffer = bufferAt(sourceModel()->index(i, 0));
+        if (buffer)
+            addEntry(buffer);
+    }
+}
+
+void ProxyBufferList::onBufferRenamed() {
+    auto buffer = qobject_cast<Buffer*>(sender());
+    if (!buffer)
+        return;
+    auto it = m_entries.find(buffer);
+    if (it == m_entries.end())
+        return;
+    it->folded = buffer->nameGet().toPlain().toCaseFolded();
+    it->score = fuzzyScore(m_foldedFilter, it->folded);
+    if (!m_foldedFilter.isEmpty())
+        invalidate();
+}
+
+void ProxyBufferList::onBufferDestroyed(QObject *buffer) {
+    m_entries.remove(buffer);
+}
+
+Buffer *ProxyBufferList::bufferAt(const QModelIndex &source_index) const {
+    return qvariant_cast<Buffer*>(sourceModel()->data(source_index));
+}
+
+void ProxyBufferList::addEntry(Buffer *buffer) {
+    if (m_entries.contains(buffer))
+        return;
+    // first time the buffer shows up, follow its name from now on
+    auto folded = buffer->nameGet().toPlain().toCaseFolded();
+    m_entries.insert(buffer, { folded, fuzzyScore(m_foldedFilter, folded) });
+    connect(buffer, &Buffer::nameChanged, this, &ProxyBufferList::onBufferRenamed);
+    connect(buffer, &QObject::destroyed, this, &ProxyBufferList::onBufferDestroyed);
+}
+
+int ProxyBufferList::scoreOf(Buffer *buffer) const {
+    auto it = m_entries.constFind(buffer);
+    if (it == m_entries.constEnd())
+        return m_foldedFilter.isEmpty() ? 0 : -1;
+    return it->score;
+}
+
+
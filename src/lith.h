@@ -24,12 +24,15 @@
 #include "windowhelper.h"
 #include "util/nicklistfilter.h"
 #include "util/messagelistfilter.h"
+#include "util/timestampformatter.h"
+#include "util/framescheduler.h"
 
 #include <QSortFilterProxyModel>
 #include <QPointer>
 
 class Weechat;
 class ProxyBufferList;
+class SearchIndex;
 
 class Buffer;
 class BufferLine;
@@ -51,6 +54,8 @@ private:
     Q_PROPERTY(QString errorString READ errorStringGet WRITE errorStringSet NOTIFY errorStringChanged)
     PROPERTY_PTR(Settings, settings)
     PROPERTY_PTR(WindowHelper, windowHelper)
+    // bumped whenever FormattedString would render differently (theme, URL shortening, timestamp format)
+    PROPERTY_READONLY(int, renderGeneration, 0)
 
     Q_PROPERTY(bool hasPassphrase READ hasPassphrase NOTIFY hasPassphraseChanged)
     //Q_PROPERTY(Weechat* weechat READ weechat CONSTANT)
@@ -82,6 +87,21 @@ public:
     NickListFilter *selectedBufferNicks();
     Q_INVOKABLE void switchToBufferNumber(int number);
 
+    SearchIndex *searchIndex();
+    TimestampFormatter *timestampFormatter();
+    // lines of all buffers matching the query, best matches first
+    Q_INVOKABLE QList<QObject*> search(const QString &query, int limit = 100);
+
+    // counters of the Nick pool, for debugging
+    Q_INVOKABLE QVariantMap allocationStatistics();
+    // how many line and nick updates got coalesced into each frame, for debugging
+    Q_INVOKABLE QVariantMap ingestStatistics();
+    // hdata keys the relay sent that no binding knows about, a newer WeeChat may have added them, for debugging
+    Q_INVOKABLE QVariantMap bindingStatistics();
+
+    // the updates queued in the buffer get applied in the next frame
+    void scheduleUpdate(Buffer *buffer);
+
     // TODO hack, this shouldn't be in this class
     Q_INVOKABLE QString getLinkFileExtension(const QString &url);
 
@@ -94,7 +114,8 @@ public slots:
     void handleHotlistInitialization(const Protocol::HData &hda);
     void handleNicklistInitialization(const Protocol::HData &hda);
 
-    void handleFetchLines(const Protocol::HData &hda);
+    void handleFetchLines(const Protocol::HData &hda, pointer_t bufPtr);
+    void handleOldestLines(const Protocol::HData &hda, pointer_t bufPtr);
     void handleHotlist(const Protocol::HData &hda);
 
     void _buffer_opened(const Protocol::HData &hda);
@@ -116,10 +137,20 @@ public slots:
     void _nicklist_diff(const Protocol::HData &hda);
     void _pong(const FormattedString &str);
 
+    void flushPendingUpdates();
+
 protected:
     void addBuffer(pointer_t ptr, Buffer *b);
     void removeBuffer(pointer_t ptr);
     Buffer *getBuffer(pointer_t ptr);
+    // keeps the line models of the few most recently shown buffers, releases those of the rest
+    void retainLineModels(Buffer *buffer);
+    // turns the lines the buffer deferred while it wasn't shown into BufferLines queued for the next frame
+    void materializeLines(Buffer *buffer);
+    // shows the stored lines of the buffer that was open last time while the relay is still connecting
+    void restoreLastOpenBuffer();
+    // materializes the largest queues until the deferred lines of all buffers fit the budget again
+    void enforceDeferredLinesBudget();
     void addLine(pointer_t bufPtr, pointer_t linePtr, BufferLine *line);
     BufferLine *getLine(pointer_t bufPtr, pointer_t linePtr);
     void addHotlist(pointer_t ptr, HotListItem *hotlist);
@@ -143,6 +174,12 @@ private:
     ProxyBufferList *m_proxyBufferList { nullptr };
     NickListFilter *m_selectedBufferNicks { nullptr };
     MessageFilterList *m_messageBufferList { nullptr };
+    SearchIndex *m_searchIndex { nullptr };
+    // made for the search results from deferred lines, they're not in any model
+    QList<QPointer<BufferLine>> m_searchResultLines {};
+    TimestampFormatter m_timestampFormatter {};
+    FrameScheduler *m_frameScheduler { nullptr };
+    QList<QPointer<Buffer>> m_buffersWithPendingUpdates {};
     int m_selectedBufferIndex { -1 };
 
     QString m_lastNetworkError {};
@@ -151,8 +188,17 @@ private:
     QMap<pointer_t, QPointer<Buffer>> m_bufferMap {};
     QMap<pointer_t, QPointer<BufferLine>> m_lineMap;
     QMap<pointer_t, QPointer<HotListItem>> m_hotList;
+    // the most recently shown first
+    QList<QPointer<Buffer>> m_buffersWithLineModels {};
 };
 
+/*
+ * Buffers matching the filter word as a fuzzy subsequence of their name, best matches first.
+ *
+ * The case folded names and their scores are kept per buffer as the buffers come in and get renamed,
+ * filterAcceptsRow and lessThan only look them up. When the filter word grows, only the buffers
+ * that matched before get scored again.
+ */
 class ProxyBufferList : public QSortFilterProxyModel {
     Q_OBJECT
     PROPERTY(QString, filterWord)
@@ -160,6 +206,29 @@ public:
     ProxyBufferList(QObject *parent = nullptr, QAbstractListModel *parentModel = nullptr);
 
     virtual bool filterAcceptsRow(int source_row, const QModelIndex &source_parent) const override;
+    virtual bool lessThan(const QModelIndex &source_left, const QModelIndex &source_right) const override;
+
+    // fzf-like score of the query found as a subsequence of the name (both case folded), -1 if it's not there
+    static int fuzzyScore(QStringView query, QStringView name);
+
+private slots:
+    void onFilterWordChanged();
+    void onRowsInserted(const QModelIndex &parent, int first, int last);
+    void onModelReset();
+    void onBufferRenamed();
+    void onBufferDestroyed(QObject *buffer);
+
+private:
+    struct Entry {
+        QString folded {};
+        int score { -1 };
+    };
+    Buffer *bufferAt(const QModelIndex &source_index) const;
+    void addEntry(Buffer *buffer);
+    int scoreOf(Buffer *buffer) const;
+
+    QString m_foldedFilter {};
+    QHash<const QObject*, Entry> m_entries {};
 };
 
 
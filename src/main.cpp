@@ -21,6 +21,7 @@
 #include "settings.h"
 #include "lith.h"
 #include "windowhelper.h"
+#include "util/messageitem.h"
 
 #include <QApplication>
 #include <QQmlApplicationEngine>
@@ -47,6 +48,9 @@ int main(int argc, char *argv[])
 
     Lith::instance();
     Lith::instance()->windowHelperGet()->init();
+    QObject::connect(&app, &QCoreApplication::aboutToQuit, []() {
+        ObjectPool<Nick>::instance().clear();
+    });
 
     auto fontFamilyFromSettings = Lith::instance()->settingsGet()->baseFontFamilyGet();
 
@@ -91,6 +95,7 @@ int main(int argc, char *argv[])
         return s.toPlain();
     });
     qmlRegisterUncreatableType<ColorTheme>("lith", 1, 0, "ColorTheme", "");
+    qmlRegisterType<MessageItem>("lith", 1, 0, "MessageItem");
     qmlRegisterUncreatableType<BufferLine>("lith", 1, 0, "Line", "");
     qmlRegisterUncreatableType<Lith>("lith", 1, 0, "Lith", "");
     qmlRegisterUncreatableType<Nick>("lith", 1, 0, "Nick", "");
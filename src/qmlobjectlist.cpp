@@ -22,7 +22,7 @@ void QmlObjectList::append(const QVariantMap& properties)
 void QmlObjectList::prepend(QObject *object) {
     Q_ASSERT(object->metaObject() == &mMetaObject);
     beginInsertRows(QModelIndex(), 0, 0);
-    mData.prepend(QObjectPointer(object));
+    mData.prepend(wrap(object));
     endInsertRows();
 }
 
@@ -37,7 +37,31 @@ bool QmlObjectList::insert(const int& i, QObject* object)
     if(i < 0 || i > rowCount())
         return false;
     beginInsertRows(QModelIndex(), i, i);
-    mData.insert(i, QObjectPointer(object));
+    mData.insert(i, wrap(object));
+    endInsertRows();
+    return true;
+}
+
+bool QmlObjectList::insertPointers(const int& i, const QList<QObjectPointer> &pointers)
+{
+    if(i < 0 || i > rowCount())
+        return false;
+    if(pointers.isEmpty())
+        return true;
+    for(const auto& pointer : pointers)
+        Q_ASSERT(pointer->metaObject() == &mMetaObject);
+    beginInsertRows(QModelIndex(), i, i + pointers.count() - 1);
+    if(i == mData.count()) {
+        mData.append(pointers);
+    }
+    else {
+        QList<QObjectPointer> merged;
+        merged.reserve(mData.count() + pointers.count());
+        merged.append(mData.mid(0, i));
+        merged.append(pointers);
+        merged.append(mData.mid(i));
+        mData.swap(merged);
+    }
     endInsertRows();
     return true;
 }
@@ -46,14 +70,31 @@ int QmlObjectList::count() {
     return rowCount();
 }
 
+void QmlObjectList::setDeleter(QObjectDeleter deleter)
+{
+    mDeleter = deleter;
+}
+
+QObjectPointer QmlObjectList::wrap(QObject *object) const
+{
+    if(mDeleter)
+        return QObjectPointer(object, mDeleter);
+    return QObjectPointer(object);
+}
+
 bool QmlObjectList::removeRow(int row, const QModelIndex &parent)
 {
-    const int first = row;
-    const int last = row;
-    if(ValidateIndex(first) || ValidateIndex(last))
+    Q_UNUSED(parent);
+    return removeRange(row, 1);
+}
+
+bool QmlObjectList::removeRange(int first, int count)
+{
+    const int last = first + count - 1;
+    if(count <= 0 || ValidateIndex(first) || ValidateIndex(last))
         return false;
-    beginRemoveRows(parent, first, last);
-    mData.removeAt(row);
+    beginRemoveRows(QModelIndex(), first, last);
+    mData.remove(first, count);
     endRemoveRows();
     return true;
 }
@@ -67,6 +108,13 @@ bool QmlObjectList::removeItem(QObject *item) {
     return false;
 }
 
+void QmlObjectList::refresh(int first, int last)
+{
+    if(ValidateIndex(first) || ValidateIndex(last))
+        return;
+    emit dataChanged(index(first), index(last));
+}
+
 QVariant QmlObjectList::data(const QModelIndex &index, int role) const
 {
     Q_UNUSED(role);
@@ -6,6 +6,7 @@
 #include <QSharedPointer>
 
 typedef QSharedPointer<QObject> QObjectPointer;
+typedef void (*QObjectDeleter)(QObject *);
 
 class QmlObjectList : public QAbstractListModel
 {
@@ -26,8 +27,44 @@ public:
 
     bool insert(const int& i, QObject *object);
 
+    /**
+     * @brief insertRange
+     * insert all objects at position i, emitting a single pair
+     * of beginInsertRows/endInsertRows for the whole batch.
+     */
+    template <typename T>
+    inline bool insertRange(const int& i, const QList<T*> &objects) {
+        QList<QObjectPointer> pointers;
+        pointers.reserve(objects.count());
+        for (auto object : objects)
+            pointers.append(wrap(object));
+        return insertPointers(i, pointers);
+    }
+
+    template <typename T>
+    inline void appendRange(const QList<T*> &objects) {
+        insertRange(rowCount(), objects);
+    }
+
+    template <typename T>
+    inline void prependRange(const QList<T*> &objects) {
+        insertRange(0, objects);
+    }
+
+    bool removeRange(int first, int count);
+
+    // notify views the objects in rows first..last changed
+    void refresh(int first, int last);
+
     int count();
 
+    /**
+     * @brief setDeleter
+     * objects removed from the list are passed to deleter
+     * instead of being deleted right away, e.g. to deleteLater them.
+     */
+    void setDeleter(QObjectDeleter deleter);
+
     void clear();
 
     Q_INVOKABLE
@@ -73,8 +110,12 @@ protected:
 private:
     QmlObjectList(const QMetaObject& m, QObject *parent = Q_NULLPTR);
 
+    bool insertPointers(const int& i, const QList<QObjectPointer> &pointers);
+    QObjectPointer wrap(QObject *object) const;
+
     const QMetaObject&              mMetaObject;
     QList<QObjectPointer>         mData;
+    QObjectDeleter                mDeleter { Q_NULLPTR };
 };
 
 #endif // QMLOBJECTLIST_H
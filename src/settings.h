@@ -44,6 +44,8 @@
 class Settings : public QObject {
     Q_OBJECT
     SETTING(int, lastOpenBuffer, -1)
+    // its stored lines are shown right at startup, before the relay is connected
+    SETTING(QString, lastOpenBufferName, "")
 #if defined(Q_OS_MACOS)
     SETTING(QString, baseFontFamily, "Menlo")
 #else
@@ -103,6 +105,15 @@ class Settings : public QObject {
     SETTING(bool, hotlistShowUnreadCount, true)
     SETTING(bool, hotlistCompact, true)
     SETTING(bool, showJoinPartQuitMessages, true)
+    // runs of join/part/quit messages are shown as a single expandable line
+    SETTING(bool, collapseJoinPartQuitMessages, true)
+
+    // keeps the lines on the disk, off unless asked for
+    SETTING(bool, scrollbackCache, false)
+    // per buffer, in kilobytes
+    SETTING(int, scrollbackCacheSize, 1024)
+    // all buffers together, in kilobytes
+    SETTING(int, scrollbackCacheTotalSize, 65536)
 
     SETTING(QString, imgurApiKey, IMGUR_API_KEY)
 
@@ -0,0 +1,348 @@
+// Lith
+// Copyright (C) 2021 Martin Bříza
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+#include "collapsedlinelist.h"
+#include "datamodel.h"
+#include "lith.h"
+
+#include <algorithm>
+#include <functional>
+
+// shorter runs are shown as they are
+static const int c_minimumCollapsedRun = 2;
+
+CollapsedLineList::CollapsedLineList(QObject *parent, QAbstractItemModel *sourceModel)
+    : QAbstractListModel(parent)
+    , m_source(sourceModel)
+{
+    auto settings = Lith::instance()->settingsGet();
+    m_collapse = settings->collapseJoinPartQuitMessagesGet();
+    connect(settings, &Settings::collapseJoinPartQuitMessagesChanged, this, [this, settings]() {
+        m_collapse = settings->collapseJoinPartQuitMessagesGet();
+        rebuild();
+    });
+    if (m_source) {
+        connect(m_source, &QAbstractItemModel::rowsInserted, this, &CollapsedLineList::onRowsInserted);
+        connect(m_source, &QAbstractItemModel::rowsAboutToBeRemoved, this, &CollapsedLineList::onRowsAboutToBeRemoved);
+        connect(m_source, &QAbstractItemModel::dataChanged, this, &CollapsedLineList::onDataChanged);
+        connect(m_source, &QAbstractItemModel::rowsMoved, this, &CollapsedLineList::rebuild);
+        connect(m_source, &QAbstractItemModel::layoutChanged, this, &CollapsedLineList::rebuild);
+        connect(m_source, &QAbstractItemModel::modelReset, this, &CollapsedLineList::rebuild);
+    }
+    rebuild();
+}
+
+int CollapsedLineList::rowCount(const QModelIndex &parent) const {
+    if (parent.isValid())
+        return 0;
+    return m_rowsToEnd.first();
+}
+
+QVariant CollapsedLineList::data(const QModelIndex &index, int role) const {
+    if (index.row() < 0 || index.row() >= rowCount())
+        return QVariant();
+    const int run = runAtRow(index.row());
+    const Run &r = m_runs[run];
+    const int offset = index.row() - rowStart(run);
+    const bool summary = isCollapsed(r) && offset == rowsOf(r) - 1;
+    // the lines under a summary row come before it, the summary itself stands for the newest one
+    const int line = lineStart(run) + (summary ? 0 : offset);
+
+    switch (role) {
+    case SummaryRole: {
+        if (!summary)
+            return QString();
+        QStringList parts;
+        if (r.joined > 0)
+            parts.append(tr("%n joined", "", r.joined));
+        if (r.left > 0)
+            parts.append(tr("%n left", "", r.left));
+        return parts.join(", ");
+    }
+    case ExpandedRole:
+        return summary && r.expanded;
+    default:
+        return QVariant::fromValue(static_cast<QObject*>(m_lines[line]));
+    }
+}
+
+QHash<int, QByteArray> CollapsedLineList::roleNames() const {
+    return {
+        { LineRole, "modelData" },
+        { SummaryRole, "summary" },
+        { ExpandedRole, "expanded" }
+    };
+}
+
+void CollapsedLineList::toggleExpanded(int row) {
+    if (row < 0 || row >= rowCount())
+        return;
+    const int run = runAtRow(row);
+    Run &r = m_runs[run];
+    if (!isCollapsed(r) || rowStart(run) + rowsOf(r) - 1 != row)
+        return;
+    if (r.expanded) {
+        beginRemoveRows(QModelIndex(), row - r.count, row - 1);
+        r.expanded = false;
+        updateOffsets(0, run);
+        endRemoveRows();
+        row -= r.count;
+    }
+    else {
+        beginInsertRows(QModelIndex(), row, row + r.count - 1);
+        r.expanded = true;
+        updateOffsets(0, run);
+        endInsertRows();
+        row += r.count;
+    }
+    emit dataChanged(index(row), index(row));
+}
+
+void CollapsedLineList::onRowsInserted(const QModelIndex &parent, int first, int last) {
+    if (parent.isValid())
+        return;
+    QVector<BufferLine*> inserted;
+    inserted.reserve(last - first + 1);
+    for (int i = first; i <= last; i++)
+        inserted.append(sourceLine(i));
+    splice(first, 0, inserted);
+}
+
+void CollapsedLineList::onRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last) {
+    if (parent.isValid())
+        return;
+    splice(first, last - first + 1, {});
+}
+
+void CollapsedLineList::onDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+    if (m_lines.isEmpty())
+        return;
+    // a line hidden under a summary shows up as the summary
+    auto rowOf = [this](int line) {
+        const int run = runAtLine(line);
+        const Run &r = m_runs[run];
+        if (isCollapsed(r) && !r.expanded)
+            return rowStart(run);
+        return rowStart(run) + line - lineStart(run);
+    };
+    const int first = qBound(0, topLeft.row(), int(m_lines.count()) - 1);
+    const int last = qBound(0, bottomRight.row(), int(m_lines.count()) - 1);
+    emit dataChanged(index(rowOf(first)), index(rowOf(last)));
+}
+
+void CollapsedLineList::rebuild() {
+    beginResetModel();
+    m_lines.clear();
+    m_runs.clear();
+    const int count = m_source ? m_source->rowCount() : 0;
+    m_lines.reserve(count);
+    for (int i = 0; i < count; i++) {
+        auto line = sourceLine(i);
+        m_lines.append(line);
+        appendRun(m_runs, runFor(line));
+    }
+    updateOffsets();
+    endResetModel();
+}
+
+CollapsedLineList::Run CollapsedLineList::runFor(const BufferLine *line) {
+    Run result;
+    if (line && line->isJoinPartQuitMsgGet()) {
+        result.joinPartQuit = true;
+        result.joined = line->tags().contains(TagDictionary::IrcJoin) ? 1 : 0;
+        result.left = result.joined ? 0 : 1;
+    }
+    return result;
+}
+
+void CollapsedLineList::appendRun(QVector<Run> &runs, const Run &run) {
+    if (!runs.isEmpty() && runs.last().joinPartQuit && run.joinPartQuit) {
+        auto &last = runs.last();
+        last.count += run.count;
+        last.joined += run.joined;
+        last.left += run.left;
+        last.expanded = last.expanded || run.expanded;
+        return;
+    }
+    runs.append(run);
+}
+
+BufferLine *CollapsedLineList::sourceLine(int sourceRow) const {
+    return qvariant_cast<BufferLine*>(m_source->data(m_source->index(sourceRow, 0)));
+}
+
+bool CollapsedLineList::isCollapsed(const Run &run) const {
+    return m_collapse && run.joinPartQuit && run.count >= c_minimumCollapsedRun;
+}
+
+int CollapsedLineList::rowsOf(const Run &run) const {
+    if (!isCollapsed(run))
+        return run.count;
+    return run.expanded ? run.count + 1 : 1;
+}
+
+void CollapsedLineList::appendTokens(const Run &run, const BufferLine * const *lines, QVector<quintptr> &tokens) const {
+    if (!isCollapsed(run) || run.expanded) {
+        for (int i = 0; i < run.count; i++)
+            tokens.append(reinterpret_cast<quintptr>(lines[i]));
+    }
+    // the oldest line stays the same while new lines join the run, objects are at least 2 aligned
+    if (isCollapsed(run))
+        tokens.append(reinterpret_cast<quintptr>(lines[run.count - 1]) | 1);
+}
+
+CollapsedLineList::Run CollapsedLineList::partOf(int run, int from, int count) const {
+    Run result = m_runs[run];
+    if (from == 0 && count == result.count)
+        return result;
+    result.count = count;
+    if (result.joinPartQuit) {
+        result.joined = 0;
+        result.left = 0;
+        const int start = lineStart(run) + from;
+        for (int i = start; i < start + count; i++) {
+            auto part = runFor(m_lines[i]);
+            result.joined += part.joined;
+            result.left += part.left;
+        }
+    }
+    return result;
+}
+
+void CollapsedLineList::splice(int position, int removed, const QVector<BufferLine*> &inserted) {
+    const int total = m_lines.count();
+
+    // the affected runs, including the neighbours the change could merge with
+    int firstRun = 0;
+    int lastRun = -1;
+    if (total > 0) {
+        firstRun = runAtLine(qMax(position - 1, 0));
+        lastRun = runAtLine(qMin(position + removed, total - 1));
+    }
+    const int firstLine = lineStart(firstRun);
+    const int endLine = lineStart(lastRun + 1);
+    const int firstRow = rowStart(firstRun);
+    const int rightStart = position + removed;
+
+    QVector<quintptr> oldTokens;
+    for (int i = firstRun; i <= lastRun; i++)
+        appendTokens(m_runs[i], m_lines.constData() + lineStart(i), oldTokens);
+
+    QVector<Run> runs;
+    QVector<BufferLine*> lines;
+    lines.reserve(endLine - firstLine - removed + inserted.count());
+    if (firstLine < position) {
+        appendRun(runs, partOf(firstRun, 0, position - firstLine));
+        for (int i = firstLine; i < position; i++)
+            lines.append(m_lines[i]);
+    }
+    for (auto line : inserted) {
+        appendRun(runs, runFor(line));
+        lines.append(line);
+    }
+    if (rightStart < endLine) {
+        appendRun(runs, partOf(lastRun, rightStart - lineStart(lastRun), endLine - rightStart));
+        for (int i = rightStart; i < endLine; i++)
+            lines.append(m_lines[i]);
+    }
+
+    QVector<quintptr> newTokens;
+    int consumed = 0;
+    for (auto &i : runs) {
+        appendTokens(i, lines.constData() + consumed, newTokens);
+        consumed += i.count;
+    }
+
+    // only the rows between the common beginning and end changed
+    int prefix = 0;
+    while (prefix < oldTokens.count() && prefix < newTokens.count() && oldTokens[prefix] == newTokens[prefix])
+        prefix++;
+    int suffix = 0;
+    while (suffix < oldTokens.count() - prefix && suffix < newTokens.count() - prefix &&
+           oldTokens[oldTokens.count() - 1 - suffix] == newTokens[newTokens.count() - 1 - suffix])
+        suffix++;
+    const int oldCount = oldTokens.count() - prefix - suffix;
+    const int newCount = newTokens.count() - prefix - suffix;
+    const int first = firstRow + prefix;
+
+    auto commit = [&]() {
+        m_lines.remove(position, removed);
+        m_lines.insert(position, inserted.count(), nullptr);
+        std::copy(inserted.begin(), inserted.end(), m_lines.begin() + position);
+        m_runs.remove(firstRun, lastRun - firstRun + 1);
+        m_runs.insert(firstRun, runs.count(), Run {});
+        std::copy(runs.begin(), runs.end(), m_runs.begin() + firstRun);
+        m_linesToEnd.remove(firstRun, lastRun - firstRun + 1);
+        m_linesToEnd.insert(firstRun, runs.count(), 0);
+        m_rowsToEnd.remove(firstRun, lastRun - firstRun + 1);
+        m_rowsToEnd.insert(firstRun, runs.count(), 0);
+        // the runs after the change keep their offsets, only the new ones and the newer lines need them
+        updateOffsets(0, firstRun + runs.count() - 1);
+    };
+    if (newCount > oldCount) {
+        beginInsertRows(QModelIndex(), first + oldCount, first + newCount - 1);
+        commit();
+        endInsertRows();
+    }
+    else if (newCount < oldCount) {
+        beginRemoveRows(QModelIndex(), first + newCount, first + oldCount - 1);
+        commit();
+        endRemoveRows();
+    }
+    else {
+        commit();
+    }
+    if (qMin(oldCount, newCount) > 0)
+        emit dataChanged(index(first), index(first + qMin(oldCount, newCount) - 1));
+    // summaries that stayed in place can still have new counts
+    for (int i = 0; i < newTokens.count(); i++) {
+        if ((newTokens[i] & 1) && (i < prefix || i >= prefix + newCount))
+            emit dataChanged(index(firstRow + i), index(firstRow + i));
+    }
+}
+
+void CollapsedLineList::updateOffsets() {
+    m_linesToEnd.resize(m_runs.count() + 1);
+    m_rowsToEnd.resize(m_runs.count() + 1);
+    m_linesToEnd.last() = 0;
+    m_rowsToEnd.last() = 0;
+    updateOffsets(0, m_runs.count() - 1);
+}
+
+void CollapsedLineList::updateOffsets(int first, int last) {
+    for (int i = last; i >= first; i--) {
+        m_linesToEnd[i] = m_linesToEnd[i + 1] + m_runs[i].count;
+        m_rowsToEnd[i] = m_rowsToEnd[i + 1] + rowsOf(m_runs[i]);
+    }
+}
+
+int CollapsedLineList::lineStart(int run) const {
+    return m_linesToEnd.first() - m_linesToEnd[run];
+}
+
+int CollapsedLineList::rowStart(int run) const {
+    return m_rowsToEnd.first() - m_rowsToEnd[run];
+}
+
+int CollapsedLineList::runAtLine(int line) const {
+    const int toEnd = m_linesToEnd.first() - line;
+    return std::upper_bound(m_linesToEnd.begin(), m_linesToEnd.end() - 1, toEnd, std::greater<int>()) - m_linesToEnd.begin() - 1;
+}
+
+int CollapsedLineList::runAtRow(int row) const {
+    const int toEnd = m_rowsToEnd.first() - row;
+    return std::upper_bound(m_rowsToEnd.begin(), m_rowsToEnd.end() - 1, toEnd, std::greater<int>()) - m_rowsToEnd.begin() - 1;
+}
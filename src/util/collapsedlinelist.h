@@ -0,0 +1,105 @@
+// Lith
+// Copyright (C) 2021 Martin Bříza
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef COLLAPSEDLINELIST_H
+#define COLLAPSEDLINELIST_H
+
+#include "common.h"
+
+#include <QAbstractListModel>
+#include <QVector>
+
+class BufferLine;
+
+/*
+ * Lines of a buffer with the runs of adjacent join/part/quit messages collapsed into a single
+ * summary row ("12 joined, 7 left"), which can be expanded to show the lines under it.
+ *
+ * The lines are grouped into runs as they're added or removed: only the runs next to the change
+ * get merged or split and views are told about the rows that actually changed. Expects lines of a
+ * single buffer as the source, newest first, summary rows carry the newest line of the run.
+ * The summary is the last row of its run, so in a view going from the bottom up like the buffer
+ * one, the expanded lines show up under it.
+ */
+class CollapsedLineList : public QAbstractListModel {
+    Q_OBJECT
+public:
+    enum Roles {
+        LineRole = Qt::UserRole,
+        SummaryRole,
+        ExpandedRole
+    };
+
+    CollapsedLineList(QObject *parent = nullptr, QAbstractItemModel *sourceModel = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    // shows or hides the lines summarized in the row
+    Q_INVOKABLE void toggleExpanded(int row);
+
+private slots:
+    void onRowsInserted(const QModelIndex &parent, int first, int last);
+    void onRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last);
+    void onDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+    void rebuild();
+
+private:
+    // consecutive join/part/quit lines, every other line is a run of its own
+    struct Run {
+        int count { 1 };
+        bool joinPartQuit { false };
+        bool expanded { false };
+        int joined { 0 };
+        int left { 0 };
+    };
+
+    static Run runFor(const BufferLine *line);
+    // adds the run to the end, merging it with the last one when both are join/part/quit
+    static void appendRun(QVector<Run> &runs, const Run &run);
+    BufferLine *sourceLine(int sourceRow) const;
+    bool isCollapsed(const Run &run) const;
+    int rowsOf(const Run &run) const;
+    // the rows of the run as the lines (or their oldest line, tagged, for a summary) they show
+    void appendTokens(const Run &run, const BufferLine * const *lines, QVector<quintptr> &tokens) const;
+    // the lines from..from+count of the run as a run of their own
+    Run partOf(int run, int from, int count) const;
+
+    // replaces removed lines at position with the inserted ones, updating only the runs around them
+    void splice(int position, int removed, const QVector<BufferLine*> &inserted);
+
+    // recomputes the offsets of all runs
+    void updateOffsets();
+    // recomputes the offsets of the runs from first to last, the ones after them have to be up to date
+    void updateOffsets(int first, int last);
+    int lineStart(int run) const;
+    int rowStart(int run) const;
+    int runAtLine(int line) const;
+    int runAtRow(int row) const;
+
+    QAbstractItemModel *m_source { nullptr };
+    bool m_collapse { true };
+    // the lines of the source in the same order
+    QVector<BufferLine*> m_lines {};
+    QVector<Run> m_runs {};
+    // lines and rows from the beginning of every run to the end of the list, with a zero at the end.
+    // Counted from the end so new lines coming in at the top leave the offsets of the older runs alone
+    QVector<int> m_linesToEnd { 0 };
+    QVector<int> m_rowsToEnd { 0 };
+};
+
+#endif // COLLAPSEDLINELIST_H
@@ -15,22 +15,27 @@ QColor ColorTheme::dim(const QColor &color) {
     return color.lighter();
 }
 
-QPalette ColorTheme::palette() const {
-    auto mix = [](const QColor &a, const QColor &b, float ratio = 0.5) {
-        return QColor {
-            static_cast<int>(a.red() * ratio + b.red() * (1 - ratio)),
-            static_cast<int>(a.green() * ratio + b.green() * (1 - ratio)),
-            static_cast<int>(a.blue() * ratio + b.blue() * (1 - ratio)),
-            static_cast<int>(a.alpha() * ratio + b.alpha() * (1 - ratio)),
-        };
-    };
+QStringList ColorTheme::weechatColorNames() const {
+    QStringList result;
+    for (auto i : m_weechatColors)
+        result.append(QColor(i).name());
+    return result;
+}
 
+QStringList ColorTheme::extendedColorNames() const {
+    QStringList result;
+    for (auto i : extendedColorPalette)
+        result.append(QColor(i).name());
+    return result;
+}
+
+QPalette ColorTheme::palette() const {
     // TODO very likely needs a bit of tweaking to differentiate button, window and base
     QColor windowText { m_weechatColors[0] };
     QColor button { m_weechatColors[1] };
-    QColor light = mix(windowText, button, 0.4f);
-    QColor dark = mix(button, windowText, 0.4f);
-    QColor mid = mix(light, dark);
+    QColor light { m_light };
+    QColor dark { m_dark };
+    QColor mid { m_mid };
     QColor text = windowText;
     QColor bright_text = text;
     QColor base = button;
@@ -3,15 +3,35 @@
 
 #include <QObject>
 #include <QString>
+#include <QStringList>
 #include <QList>
 #include <QColor>
 #include <QPalette>
 
+#include <array>
+
+// the xterm 256 color palette: 16 system colors, a 6x6x6 color cube and 24 shades of gray, packed as 0xRRGGBB
+inline constexpr std::array<QRgb, 256> extendedColorPalette = []() {
+    std::array<QRgb, 256> result {};
+    constexpr QRgb system[] {
+        0x000000, 0x800000, 0x008000, 0x808000, 0x000080, 0x800080, 0x008080, 0xc0c0c0,
+        0x808080, 0xff0000, 0x00ff00, 0xffff00, 0x0000ff, 0xff00ff, 0x00ffff, 0xffffff
+    };
+    constexpr int levels[] { 0x00, 0x5f, 0x87, 0xaf, 0xd7, 0xff };
+    for (int i = 0; i < 16; i++)
+        result[i] = system[i];
+    for (int i = 0; i < 216; i++)
+        result[16 + i] = QRgb(levels[i / 36] << 16 | levels[i / 6 % 6] << 8 | levels[i % 6]);
+    for (int i = 0; i < 24; i++)
+        result[232 + i] = QRgb(0x010101 * (8 + 10 * i));
+    return result;
+}();
+
 class ColorTheme {
     Q_GADGET
     Q_PROPERTY(QString name READ name CONSTANT)
-    Q_PROPERTY(QStringList weechatColors READ weechatColors CONSTANT)
-    Q_PROPERTY(QStringList extendedColors READ extendedColors CONSTANT)
+    Q_PROPERTY(QStringList weechatColors READ weechatColorNames CONSTANT)
+    Q_PROPERTY(QStringList extendedColors READ extendedColorNames CONSTANT)
 
     Q_PROPERTY(QPalette palette READ palette CONSTANT)
 public:
@@ -42,157 +62,76 @@ public:
         WHITE,
         _LAST_WEECHAT_COLOR
     };
+    using WeechatPalette = std::array<QRgb, _LAST_WEECHAT_COLOR>;
+    // shown for colors the theme doesn't have
+    static constexpr QRgb InvalidColor = 0xffc0cb;
 
-    ColorTheme(Group group = LIGHT, const QString &name = {}, const QStringList &weechatColors = {}, const QStringList &extendedColors = {})
-        : m_group(group), m_name(name), m_weechatColors(weechatColors), m_extendedColors(extendedColors)
+    // the colors derived from the palette get computed along with the theme, at compile time for the built-in ones
+    constexpr ColorTheme(Group group = LIGHT, const char *name = "", const WeechatPalette &weechatColors = {})
+        : m_group(group), m_name(name), m_weechatColors(weechatColors)
+        , m_light(mix(weechatColors[0], weechatColors[1], 0.4f))
+        , m_dark(mix(weechatColors[1], weechatColors[0], 0.4f))
+        , m_mid(mix(m_light, m_dark))
     {}
 
     Q_INVOKABLE QString getIcon(const QString &name);
     Q_INVOKABLE QColor dim(const QColor &color);
 
-    QString name() const { return m_name; }
-    const QStringList &weechatColors() const { return m_weechatColors; }
-    const QStringList &extendedColors() const { return m_extendedColors; }
+    QString name() const { return QLatin1String(m_name); }
+
+    // a single indexed load, the index is only checked to be in range
+    constexpr QRgb color(int index, bool extended) const {
+        if (extended)
+            return index >= 0 && index < ExtendedColorCount ? extendedColorPalette[index] : InvalidColor;
+        return index >= 0 && index < _LAST_WEECHAT_COLOR ? m_weechatColors[index] : InvalidColor;
+    }
+
+    QStringList weechatColorNames() const;
+    QStringList extendedColorNames() const;
 
     QPalette palette() const;
 
 private:
+    static constexpr QRgb mix(QRgb a, QRgb b, float ratio = 0.5f) {
+        return static_cast<QRgb>(qRed(a) * ratio + qRed(b) * (1 - ratio)) << 16 |
+               static_cast<QRgb>(qGreen(a) * ratio + qGreen(b) * (1 - ratio)) << 8 |
+               static_cast<QRgb>(qBlue(a) * ratio + qBlue(b) * (1 - ratio));
+    }
+
     Group m_group;
-    QString m_name;
-    QStringList m_weechatColors;
-    QStringList m_extendedColors;
+    const char *m_name;
+    WeechatPalette m_weechatColors;
+    // the palette() mix
+    QRgb m_light;
+    QRgb m_dark;
+    QRgb m_mid;
 };
 Q_DECLARE_METATYPE(ColorTheme)
 
-static inline const ColorTheme lightTheme {
+inline constexpr ColorTheme lightTheme {
     ColorTheme::LIGHT, "light",
     {
-        "black",   "white",   "#444444", "#880000", "#ff4444", "#008800", "#33cc33", "#d2691e",
-        "#dddd00", "#000088", "#3333dd", "#660066", "#ff44ff", "#006666", "#22aaaa", "#aaaaaa",
-        "#ffffff"
-    },
-    // TODO extended colors are the same for light and dark theme
-    {
-        "#000000", "#800000", "#008000", "#808000", "#000080", "#800080", "#008080", "#c0c0c0",
-        "#808080", "#ff0000", "#00ff00", "#ffff00", "#0000ff", "#ff00ff", "#00ffff", "#ffffff",
-        "#000000", "#00005f", "#000087", "#0000af", "#0000d7", "#0000ff", "#005f00", "#005f5f",
-        "#005f87", "#005faf", "#005fd7", "#005fff", "#008700", "#00875f", "#008787", "#0087af",
-        "#0087d7", "#0087ff", "#00af00", "#00af5f", "#00af87", "#00afaf", "#00afd7", "#00afff",
-        "#00d700", "#00d75f", "#00d787", "00d7af ", "#00d7d7", "#00d7ff", "#00ff00", "#00ff5f",
-        "#00ff87", "#00ffaf", "#00ffd7", "#00ffff", "#5f0000", "#5f005f", "#5f0087", "#5f00af",
-        "#5f00d7", "#5f00ff", "#5f5f00", "#5f5f5f", "#5f5f87", "#5f5faf", "#5f5fd7", "#5f5fff",
-        "#5f8700", "#5f875f", "#5f8787", "#5f87af", "#5f87d7", "#5f87ff", "#5faf00", "#5faf5f",
-        "#5faf87", "#5fafaf", "#5fafd7", "#5fafff", "#5fd700", "#5fd75f", "#5fd787", "#5fd7af",
-        "#5fd7d7", "#5fd7ff", "#5fff00", "#5fff5f", "#5fff87", "#5fffaf", "#5fffd7", "#5fffff",
-        "#870000", "#87005f", "#870087", "#8700af", "#8700d7", "#8700ff", "#875f00", "#875f5f",
-        "#875f87", "#875faf", "#875fd7", "#875fff", "#878700", "#87875f", "#878787", "#8787af",
-        "#8787d7", "#8787ff", "#87af00", "#87af5f", "#87af87", "#87afaf", "#87afd7", "#87afff",
-        "#87d700", "#87d75f", "#87d787", "#87d7af", "#87d7d7", "#87d7ff", "#87ff00", "#87ff5f",
-        "#87ff87", "#87ffaf", "#87ffd7", "#87ffff", "#af0000", "#af005f", "#af0087", "#af00af",
-        "#af00d7", "#af00ff", "#af5f00", "#af5f5f", "#af5f87", "#af5faf", "#af5fd7", "#af5fff",
-        "#af8700", "#af875f", "#af8787", "#af87af", "#af87d7", "#af87ff", "#afaf00", "#afaf5f",
-        "#afaf87", "#afafaf", "#afafd7", "#afafff", "#afd700", "#afd75f", "#afd787", "#afd7af",
-        "#afd7d7", "#afd7ff", "#afff00", "#afff5f", "#afff87", "#afffaf", "#afffd7", "#afffff",
-        "#d70000", "#d7005f", "#d70087", "#d700af", "#d700d7", "#d700ff", "#d75f00", "#d75f5f",
-        "#d75f87", "#d75faf", "#d75fd7", "#d75fff", "#d78700", "#d7875f", "#d78787", "#d787af",
-        "#d787d7", "#d787ff", "#d7af00", "#d7af5f", "#d7af87", "#d7afaf", "#d7afd7", "#d7afff",
-        "#d7d700", "#d7d75f", "#d7d787", "#d7d7af", "#d7d7d7", "#d7d7ff", "#d7ff00", "#d7ff5f",
-        "#d7ff87", "#d7ffaf", "#d7ffd7", "#d7ffff", "#ff0000", "#ff005f", "#ff0087", "#ff00af",
-        "#ff00d7", "#ff00ff", "#ff5f00", "#ff5f5f", "#ff5f87", "#ff5faf", "#ff5fd7", "#ff5fff",
-        "#ff8700", "#ff875f", "#ff8787", "#ff87af", "#ff87d7", "#ff87ff", "#ffaf00", "#ffaf5f",
-        "#ffaf87", "#ffafaf", "#ffafd7", "#ffafff", "#ffd700", "#ffd75f", "#ffd787", "#ffd7af",
-        "#ffd7d7", "#ffd7ff", "#ffff00", "#ffff5f", "#ffff87", "#ffffaf", "#ffffd7", "#ffffff",
-        "#080808", "#121212", "#1c1c1c", "#262626", "#303030", "#3a3a3a", "#444444", "#4e4e4e",
-        "#585858", "#626262", "#6c6c6c", "#767676", "#808080", "#8a8a8a", "#949494", "#9e9e9e",
-        "#a8a8a8", "#b2b2b2", "#bcbcbc", "#c6c6c6", "#d0d0d0", "#dadada", "#e4e4e4", "#eeeeee"
+        0x000000, 0xffffff, 0x444444, 0x880000, 0xff4444, 0x008800, 0x33cc33, 0xd2691e,
+        0xdddd00, 0x000088, 0x3333dd, 0x660066, 0xff44ff, 0x006666, 0x22aaaa, 0xaaaaaa,
+        0xffffff
     }
 };
 
-static inline const ColorTheme darkTheme {
+inline constexpr ColorTheme darkTheme {
     ColorTheme::DARK, "dark",
     {
-        "#ffffff", "#2c2829", "#444444", "#880000", "#ff4444", "#33dd33", "#55ff55", "#d2691e",
-        "#ffff00", "#4444ff", "#9999ff", "#ee44ee", "#ff88ff", "#22aaaa", "#44dddd", "#aaaaaa",
-        "#ffffff"
-    },
-    // TODO extended colors are the same for light and dark theme
-    {
-        "#000000", "#800000", "#008000", "#808000", "#000080", "#800080", "#008080", "#c0c0c0",
-        "#808080", "#ff0000", "#00ff00", "#ffff00", "#0000ff", "#ff00ff", "#00ffff", "#ffffff",
-        "#000000", "#00005f", "#000087", "#0000af", "#0000d7", "#0000ff", "#005f00", "#005f5f",
-        "#005f87", "#005faf", "#005fd7", "#005fff", "#008700", "#00875f", "#008787", "#0087af",
-        "#0087d7", "#0087ff", "#00af00", "#00af5f", "#00af87", "#00afaf", "#00afd7", "#00afff",
-        "#00d700", "#00d75f", "#00d787", "00d7af ", "#00d7d7", "#00d7ff", "#00ff00", "#00ff5f",
-        "#00ff87", "#00ffaf", "#00ffd7", "#00ffff", "#5f0000", "#5f005f", "#5f0087", "#5f00af",
-        "#5f00d7", "#5f00ff", "#5f5f00", "#5f5f5f", "#5f5f87", "#5f5faf", "#5f5fd7", "#5f5fff",
-        "#5f8700", "#5f875f", "#5f8787", "#5f87af", "#5f87d7", "#5f87ff", "#5faf00", "#5faf5f",
-        "#5faf87", "#5fafaf", "#5fafd7", "#5fafff", "#5fd700", "#5fd75f", "#5fd787", "#5fd7af",
-        "#5fd7d7", "#5fd7ff", "#5fff00", "#5fff5f", "#5fff87", "#5fffaf", "#5fffd7", "#5fffff",
-        "#870000", "#87005f", "#870087", "#8700af", "#8700d7", "#8700ff", "#875f00", "#875f5f",
-        "#875f87", "#875faf", "#875fd7", "#875fff", "#878700", "#87875f", "#878787", "#8787af",
-        "#8787d7", "#8787ff", "#87af00", "#87af5f", "#87af87", "#87afaf", "#87afd7", "#87afff",
-        "#87d700", "#87d75f", "#87d787", "#87d7af", "#87d7d7", "#87d7ff", "#87ff00", "#87ff5f",
-        "#87ff87", "#87ffaf", "#87ffd7", "#87ffff", "#af0000", "#af005f", "#af0087", "#af00af",
-        "#af00d7", "#af00ff", "#af5f00", "#af5f5f", "#af5f87", "#af5faf", "#af5fd7", "#af5fff",
-        "#af8700", "#af875f", "#af8787", "#af87af", "#af87d7", "#af87ff", "#afaf00", "#afaf5f",
-        "#afaf87", "#afafaf", "#afafd7", "#afafff", "#afd700", "#afd75f", "#afd787", "#afd7af",
-        "#afd7d7", "#afd7ff", "#afff00", "#afff5f", "#afff87", "#afffaf", "#afffd7", "#afffff",
-        "#d70000", "#d7005f", "#d70087", "#d700af", "#d700d7", "#d700ff", "#d75f00", "#d75f5f",
-        "#d75f87", "#d75faf", "#d75fd7", "#d75fff", "#d78700", "#d7875f", "#d78787", "#d787af",
-        "#d787d7", "#d787ff", "#d7af00", "#d7af5f", "#d7af87", "#d7afaf", "#d7afd7", "#d7afff",
-        "#d7d700", "#d7d75f", "#d7d787", "#d7d7af", "#d7d7d7", "#d7d7ff", "#d7ff00", "#d7ff5f",
-        "#d7ff87", "#d7ffaf", "#d7ffd7", "#d7ffff", "#ff0000", "#ff005f", "#ff0087", "#ff00af",
-        "#ff00d7", "#ff00ff", "#ff5f00", "#ff5f5f", "#ff5f87", "#ff5faf", "#ff5fd7", "#ff5fff",
-        "#ff8700", "#ff875f", "#ff8787", "#ff87af", "#ff87d7", "#ff87ff", "#ffaf00", "#ffaf5f",
-        "#ffaf87", "#ffafaf", "#ffafd7", "#ffafff", "#ffd700", "#ffd75f", "#ffd787", "#ffd7af",
-        "#ffd7d7", "#ffd7ff", "#ffff00", "#ffff5f", "#ffff87", "#ffffaf", "#ffffd7", "#ffffff",
-        "#080808", "#121212", "#1c1c1c", "#262626", "#303030", "#3a3a3a", "#444444", "#4e4e4e",
-        "#585858", "#626262", "#6c6c6c", "#767676", "#808080", "#8a8a8a", "#949494", "#9e9e9e",
-        "#a8a8a8", "#b2b2b2", "#bcbcbc", "#c6c6c6", "#d0d0d0", "#dadada", "#e4e4e4", "#eeeeee"
+        0xffffff, 0x2c2829, 0x444444, 0x880000, 0xff4444, 0x33dd33, 0x55ff55, 0xd2691e,
+        0xffff00, 0x4444ff, 0x9999ff, 0xee44ee, 0xff88ff, 0x22aaaa, 0x44dddd, 0xaaaaaa,
+        0xffffff
     }
 };
 
-static inline const ColorTheme blackTheme {
+inline constexpr ColorTheme blackTheme {
     ColorTheme::DARK, "black",
     {
-        "white",   "black",   "#444444", "#880000", "#ff4444", "#33dd33", "#55ff55", "#d2691e",
-        "#ffff00", "#4444ff", "#9999ff", "#ee44ee", "#ff88ff", "#22aaaa", "#44dddd", "#aaaaaa",
-        "#ffffff"
-    },
-    // TODO extended colors are the same for light and dark theme
-    {
-        "#000000", "#800000", "#008000", "#808000", "#000080", "#800080", "#008080", "#c0c0c0",
-        "#808080", "#ff0000", "#00ff00", "#ffff00", "#0000ff", "#ff00ff", "#00ffff", "#ffffff",
-        "#000000", "#00005f", "#000087", "#0000af", "#0000d7", "#0000ff", "#005f00", "#005f5f",
-        "#005f87", "#005faf", "#005fd7", "#005fff", "#008700", "#00875f", "#008787", "#0087af",
-        "#0087d7", "#0087ff", "#00af00", "#00af5f", "#00af87", "#00afaf", "#00afd7", "#00afff",
-        "#00d700", "#00d75f", "#00d787", "00d7af ", "#00d7d7", "#00d7ff", "#00ff00", "#00ff5f",
-        "#00ff87", "#00ffaf", "#00ffd7", "#00ffff", "#5f0000", "#5f005f", "#5f0087", "#5f00af",
-        "#5f00d7", "#5f00ff", "#5f5f00", "#5f5f5f", "#5f5f87", "#5f5faf", "#5f5fd7", "#5f5fff",
-        "#5f8700", "#5f875f", "#5f8787", "#5f87af", "#5f87d7", "#5f87ff", "#5faf00", "#5faf5f",
-        "#5faf87", "#5fafaf", "#5fafd7", "#5fafff", "#5fd700", "#5fd75f", "#5fd787", "#5fd7af",
-        "#5fd7d7", "#5fd7ff", "#5fff00", "#5fff5f", "#5fff87", "#5fffaf", "#5fffd7", "#5fffff",
-        "#870000", "#87005f", "#870087", "#8700af", "#8700d7", "#8700ff", "#875f00", "#875f5f",
-        "#875f87", "#875faf", "#875fd7", "#875fff", "#878700", "#87875f", "#878787", "#8787af",
-        "#8787d7", "#8787ff", "#87af00", "#87af5f", "#87af87", "#87afaf", "#87afd7", "#87afff",
-        "#87d700", "#87d75f", "#87d787", "#87d7af", "#87d7d7", "#87d7ff", "#87ff00", "#87ff5f",
-        "#87ff87", "#87ffaf", "#87ffd7", "#87ffff", "#af0000", "#af005f", "#af0087", "#af00af",
-        "#af00d7", "#af00ff", "#af5f00", "#af5f5f", "#af5f87", "#af5faf", "#af5fd7", "#af5fff",
-        "#af8700", "#af875f", "#af8787", "#af87af", "#af87d7", "#af87ff", "#afaf00", "#afaf5f",
-        "#afaf87", "#afafaf", "#afafd7", "#afafff", "#afd700", "#afd75f", "#afd787", "#afd7af",
-        "#afd7d7", "#afd7ff", "#afff00", "#afff5f", "#afff87", "#afffaf", "#afffd7", "#afffff",
-        "#d70000", "#d7005f", "#d70087", "#d700af", "#d700d7", "#d700ff", "#d75f00", "#d75f5f",
-        "#d75f87", "#d75faf", "#d75fd7", "#d75fff", "#d78700", "#d7875f", "#d78787", "#d787af",
-        "#d787d7", "#d787ff", "#d7af00", "#d7af5f", "#d7af87", "#d7afaf", "#d7afd7", "#d7afff",
-        "#d7d700", "#d7d75f", "#d7d787", "#d7d7af", "#d7d7d7", "#d7d7ff", "#d7ff00", "#d7ff5f",
-        "#d7ff87", "#d7ffaf", "#d7ffd7", "#d7ffff", "#ff0000", "#ff005f", "#ff0087", "#ff00af",
-        "#ff00d7", "#ff00ff", "#ff5f00", "#ff5f5f", "#ff5f87", "#ff5faf", "#ff5fd7", "#ff5fff",
-        "#ff8700", "#ff875f", "#ff8787", "#ff87af", "#ff87d7", "#ff87ff", "#ffaf00", "#ffaf5f",
-        "#ffaf87", "#ffafaf", "#ffafd7", "#ffafff", "#ffd700", "#ffd75f", "#ffd787", "#ffd7af",
-        "#ffd7d7", "#ffd7ff", "#ffff00", "#ffff5f", "#ffff87", "#ffffaf", "#ffffd7", "#ffffff",
-        "#080808", "#121212", "#1c1c1c", "#262626", "#303030", "#3a3a3a", "#444444", "#4e4e4e",
-        "#585858", "#626262", "#6c6c6c", "#767676", "#808080", "#8a8a8a", "#949494", "#9e9e9e",
-        "#a8a8a8", "#b2b2b2", "#bcbcbc", "#c6c6c6", "#d0d0d0", "#dadada", "#e4e4e4", "#eeeeee"
+        0xffffff, 0x000000, 0x444444, 0x880000, 0xff4444, 0x33dd33, 0x55ff55, 0xd2691e,
+        0xffff00, 0x4444ff, 0x9999ff, 0xee44ee, 0xff88ff, 0x22aaaa, 0x44dddd, 0xaaaaaa,
+        0xffffff
     }
 };
 
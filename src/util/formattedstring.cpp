@@ -20,43 +20,118 @@
 #include "windowhelper.h"
 #include "lith.h"
 
-#include <QRegularExpression>
 #include <QDebug>
 #include <QUrl>
+#include <QCache>
+#include <QThread>
+
+#include <array>
+
+/*
+ * URL detection, a hand-written equivalent of what used to be this regular expression (case insensitive):
+ *   ((?:(?:https?|ftp|file):\/\/|www\.|ftp\.)(?:\([-A-Z0-9+&@#\/%=~_|$?!:,.;]*\)|[-A-Z0-9+&@#\/%=~_|$?!:,.;])*(?:\([-A-Z0-9+&@#\/%=~_|$?!:,.;]*\)|[A-Z0-9+&@#\/%=~_|$;]))
+ * (; was added to handle &amp; escapes right)
+ *
+ * After the prefix, the URL is a sequence of characters and parenthesized groups. Parentheses can't nest
+ * so that sequence is unambiguous and the regex ends up matching up to the last group or character
+ * allowed at the end. That can be found in a single pass without any backtracking.
+ */
+enum UrlCharacterClass : quint8 {
+    // can be anywhere in the URL
+    UrlBody = 1 << 0,
+    // can also be the last character
+    UrlEnd = 1 << 1,
+};
+
+static constexpr std::array<quint8, 128> urlCharacterClasses() {
+    std::array<quint8, 128> result {};
+    for (int i = '0'; i <= '9'; i++)
+        result[i] = UrlBody | UrlEnd;
+    for (int i = 'a'; i <= 'z'; i++)
+        result[i] = result[i - 'a' + 'A'] = UrlBody | UrlEnd;
+    for (const char *i = "+&@#/%=~_|$;"; *i; i++)
+        result[*i] = UrlBody | UrlEnd;
+    for (const char *i = "-?!:,."; *i; i++)
+        result[*i] = UrlBody;
+    return result;
+}
+static constexpr auto c_urlCharacterClasses = urlCharacterClasses();
 
-QString FormattedString::Part::toHtml(const ColorTheme &theme) const {
-    QString ret;
-    if (bold)
-        ret.append("<b>");
-    if (underline)
-        ret.append("<u>");
-    if (foreground.index >= 0) {
-        ret.append("<font color=\"");
-        if (foreground.extended) {
-            if (theme.extendedColors().count() > foreground.index)
-                ret.append(theme.extendedColors()[foreground.index]);
-            else
-                ret.append("pink");
+static inline bool isUrlCharacter(QChar c, UrlCharacterClass cls) {
+    return c.unicode() < c_urlCharacterClasses.size() && (c_urlCharacterClasses[c.unicode()] & cls);
+}
+
+static int urlPrefixLength(QStringView text, int pos) {
+    // the order matters, "https://" has to be tried before "http://"
+    for (const char *prefix : { "https://", "http://", "ftp://", "file://", "www.", "ftp." }) {
+        int i = 0;
+        while (prefix[i] && pos + i < text.size() && text[pos + i].unicode() < 128 && QChar::toLower(text[pos + i].unicode()) == prefix[i])
+            i++;
+        if (!prefix[i])
+            return i;
+    }
+    return 0;
+}
+
+bool FormattedString::findUrl(QStringView text, int from, int *start, int *length) {
+    for (int pos = from; pos < text.size(); pos++) {
+        // cheap rejection before trying the prefixes
+        const auto first = QChar::toLower(text[pos].unicode());
+        if (first != 'h' && first != 'f' && first != 'w')
+            continue;
+        const int prefix = urlPrefixLength(text, pos);
+        if (prefix == 0)
+            continue;
+
+        int end = -1;
+        int i = pos + prefix;
+        while (i < text.size()) {
+            if (text[i] == '(') {
+                int close = i + 1;
+                while (close < text.size() && isUrlCharacter(text[close], UrlBody))
+                    close++;
+                if (close >= text.size() || text[close] != ')')
+                    break;
+                i = close + 1;
+                end = i;
+            }
+            else if (isUrlCharacter(text[i], UrlBody)) {
+                if (isUrlCharacter(text[i], UrlEnd))
+                    end = i + 1;
+                i++;
+            }
+            else {
+                break;
+            }
         }
-        else {
-            if (theme.weechatColors().count() > foreground.index)
-                ret.append(theme.weechatColors()[foreground.index]);
-            else
-                ret.append("pink");
+        if (end > 0) {
+            *start = pos;
+            *length = end - pos;
+            return true;
         }
-        ret.append("\">");
-    }
-    if (hyperlink) {
-        ret.append("<a href=\"");
-        ret.append(text);
-        ret.append("\">");
     }
+    return false;
+}
 
+bool FormattedString::Part::sameFormatting(const Part &o) const {
+    return foreground.index == o.foreground.index && foreground.extended == o.foreground.extended &&
+           background.index == o.background.index && background.extended == o.background.extended &&
+           hyperlink == o.hyperlink && bold == o.bold && underline == o.underline && italic == o.italic;
+}
+
+QRgb FormattedString::Part::foregroundColor(const ColorTheme &theme) const {
+    return theme.color(foreground.index, foreground.extended);
+}
+
+QString FormattedString::Part::displayText(QStringView text) const {
+    const auto settings = Lith::instance()->settingsGet();
+    return displayText(text, settings->shortenLongUrlsGet() ? settings->shortenLongUrlsThresholdGet() : 0);
+}
+
+QString FormattedString::Part::displayText(QStringView text, int urlThreshold) const {
     QString finalText;
-    const auto urlThreshold = Lith::instance()->settingsGet()->shortenLongUrlsThresholdGet();
-    const auto urlShortenEnabled = Lith::instance()->settingsGet()->shortenLongUrlsGet();
-    if (urlThreshold > 0 && hyperlink && text.size() > urlThreshold && urlShortenEnabled) {
-        auto url = QUrl(text);
+    if (urlThreshold > 0 && hyperlink && text.size() > urlThreshold) {
+        auto url = QUrl(text.toString());
         auto scheme = url.scheme();
         auto host = url.host();
         auto file = url.fileName();
@@ -65,7 +140,7 @@ QString FormattedString::Part::toHtml(const ColorTheme &theme) const {
 
         // If we only have a hostname, we'll use it as is.
         if (path.isEmpty() || path == "/") {
-            finalText = text;
+            finalText = text.toString();
         }
         else {
             // We'll show always show the host and the scheme.
@@ -81,7 +156,7 @@ QString FormattedString::Part::toHtml(const ColorTheme &theme) const {
                 // This is a "nice" url with just a hostname and then one path fragment. We'll let these slide, because these tend
                 // to look nice even if they're long. Something like https://host.domain/file.extension
                 if (path == "/" + file && !url.hasQuery()) {
-                    finalText = text;
+                    finalText = text.toString();
                 }
                 else {
                     // Otherwise it's a weird link with multiple path fragments and queries and stuff. We'll just use the host and 10
@@ -93,9 +168,29 @@ QString FormattedString::Part::toHtml(const ColorTheme &theme) const {
         }
     }
     else {
-        finalText = text;
+        finalText = text.toString();
     }
-    ret.append(finalText.toHtmlEscaped());
+    return finalText;
+}
+
+QString FormattedString::Part::toHtml(QStringView text, const ColorTheme &theme) const {
+    QString ret;
+    if (bold)
+        ret.append("<b>");
+    if (underline)
+        ret.append("<u>");
+    if (foreground.index >= 0) {
+        ret.append("<font color=\"");
+        ret.append(QColor(foregroundColor(theme)).name());
+        ret.append("\">");
+    }
+    if (hyperlink) {
+        ret.append("<a href=\"");
+        ret.append(text);
+        ret.append("\">");
+    }
+
+    ret.append(displayText(text).toHtmlEscaped());
 
     if (hyperlink) {
         ret.append("</a>");
@@ -109,29 +204,55 @@ QString FormattedString::Part::toHtml(const ColorTheme &theme) const {
     return ret;
 }
 
+struct HtmlCacheEntry {
+    int generation;
+    const ColorTheme *theme;
+    QString html;
+};
+
+// rendered HTML of the recently displayed strings keyed by the string and the trimming length (-1 for none),
+// bounded by the total length of the HTML, the least recently used entries get dropped first
+static QCache<QPair<quint64, int>, HtmlCacheEntry> &htmlCache() {
+    static QCache<QPair<quint64, int>, HtmlCacheEntry> cache(4 * 1024 * 1024);
+    return cache;
+}
+
+const QSharedDataPointer<FormattedString::Data> &FormattedString::emptyData() {
+    static const QSharedDataPointer<Data> empty = [] {
+        QSharedDataPointer<Data> d(new Data);
+        d->parts.append(Part());
+        return d;
+    }();
+    return empty;
+}
+
 FormattedString::FormattedString()
-    : m_parts({QString()})
+    : d(emptyData())
 {}
 
-FormattedString::FormattedString(const char *d)
-    : m_parts({QString(d)})
+FormattedString::FormattedString(const char *o)
+    : FormattedString(QString(o))
 {}
 
 FormattedString::FormattedString(const QString &o)
-    : m_parts({o})
+    : FormattedString(QString(o))
 {}
 
 FormattedString::FormattedString(QString &&o)
-    : m_parts({std::move(o)})
-{}
+    : d(emptyData())
+{
+    if (!o.isEmpty()) {
+        d->parts.last().length = o.size();
+        d->text = std::move(o);
+    }
+}
 
 FormattedString &FormattedString::operator=(const char *o) {
-    m_parts = { QString(o) };
-    return *this;
+    return *this = FormattedString(o);
 }
 
 bool FormattedString::operator==(const QString &o) {
-    return toPlain() == o;
+    return d->text == o;
 }
 
 bool FormattedString::operator!=(const QString &o) {
@@ -139,7 +260,11 @@ bool FormattedString::operator!=(const QString &o) {
 }
 
 FormattedString &FormattedString::operator+=(const QString &s) {
-    lastPart().text += s;
+    if (s.isEmpty())
+        return *this;
+    d->text += s;
+    d->cacheKey = 0;
+    d->parts.last().length += s.size();
     return *this;
 }
 
@@ -148,41 +273,76 @@ const ColorTheme &FormattedString::getCurrentTheme() {
 }
 
 void FormattedString::clear() {
-    m_parts = {{}};
+    d = emptyData();
 }
 
 FormattedString::Part &FormattedString::addPart(const FormattedString::Part &p) {
-    m_parts.append(p);
-    return m_parts.last();
+    d->cacheKey = 0;
+    Part part = p;
+    part.offset = d->text.size();
+    part.length = 0;
+    // formatting changes often come one after another, a run that got no text is just reused
+    if (d->parts.last().length == 0)
+        d->parts.last() = part;
+    else
+        d->parts.append(part);
+    return d->parts.last();
 }
 
 QString FormattedString::toPlain() const {
-    QString ret;
-    for (auto &i : m_parts) {
-        ret.append(i.text);
-    }
-    return ret;
+    return d->text;
 }
 
 QString FormattedString::toHtml(const ColorTheme &theme) const {
+    return cachedHtml(-1, theme);
+}
+
+QString FormattedString::toTrimmedHtml(int n, const ColorTheme &theme) const {
+    if (n <= 0)
+        return toHtml(theme);
+    return cachedHtml(n, theme);
+}
+
+QString FormattedString::cachedHtml(int n, const ColorTheme &theme) const {
+    // the cache isn't thread safe, it's only meant for what QML reads
+    auto lith = Lith::instance();
+    if (QThread::currentThread() != lith->thread())
+        return n < 0 ? renderHtml(theme) : renderTrimmedHtml(n, theme);
+
+    // assigned on the first render, it's only ever touched from the main thread
+    static quint64 nextCacheKey = 1;
+    const Data &data = *std::as_const(d);
+    if (!data.cacheKey)
+        data.cacheKey = nextCacheKey++;
+
+    const int generation = lith->renderGenerationGet();
+    const auto key = qMakePair(data.cacheKey, n);
+    auto entry = htmlCache().object(key);
+    if (entry && entry->generation == generation && entry->theme == &theme)
+        return entry->html;
+
+    auto html = n < 0 ? renderHtml(theme) : renderTrimmedHtml(n, theme);
+    htmlCache().insert(key, new HtmlCacheEntry { generation, &theme, html }, html.size());
+    return html;
+}
+
+QString FormattedString::renderHtml(const ColorTheme &theme) const {
     QString ret { "<html><body><span style='white-space: pre-wrap;'>" };
-    for (auto &i : m_parts) {
-        ret.append(i.toHtml(theme));
+    QStringView text(d->text);
+    for (auto &i : d->parts) {
+        ret.append(i.toHtml(text.mid(i.offset, i.length), theme));
     }
     ret.append("</span></body></html>");
     return ret;
 }
 
-QString FormattedString::toTrimmedHtml(int n, const ColorTheme &theme) const {
-    if (n <= 0)
-        return toHtml(theme);
+QString FormattedString::renderTrimmedHtml(int n, const ColorTheme &theme) const {
     QString ret = "<html><body><span style='white-space: pre-wrap;'>";
-    for (auto &i : m_parts) {
-        QString word = i.text.left(n);
-        Part tempPart = i;
-        tempPart.text = word;
-        ret.append(tempPart.toHtml(theme));
-        n -= word.count();
+    QStringView text(d->text);
+    for (auto &i : d->parts) {
+        auto word = text.mid(i.offset, qMin<int>(i.length, n));
+        ret.append(i.toHtml(word, theme));
+        n -= word.size();
         if (n <= 0)
             break;
     }
@@ -195,81 +355,71 @@ QString FormattedString::toTrimmedHtml(int n, const ColorTheme &theme) const {
 }
 
 bool FormattedString::containsHtml() const {
-    return m_parts.count() > 1 || m_parts.first().containsHtml();
+    return d->parts.count() > 1 || d->parts.first().containsHtml();
 }
 
 FormattedString::Part &FormattedString::lastPart() {
-    return m_parts.last();
+    // the part is likely to be modified through the reference
+    d->cacheKey = 0;
+    return d->parts.last();
 }
 
 void FormattedString::prune() {
-    auto it = m_parts.begin();
-    while (it != m_parts.end()) {
-        // Originally: QRegExp re(R"(((?:(?:https?|ftp|file):\/\/|www\.|ftp\.)(?:\([-A-Z0-9+&@#\/%=~_|$?!:,.]*\)|[-A-Z0-9+&@#\/%=~_|$?!:,.])*(?:\([-A-Z0-9+&@#\/%=~_|$?!:,.]*\)|[A-Z0-9+&@#\/%=~_|$])))", Qt::CaseInsensitive, QRegExp::W3CXmlSchema11);
-        // ; was added to handle &amp; escapes right
-
-        QRegularExpression re(R"(((?:(?:https?|ftp|file):\/\/|www\.|ftp\.)(?:\([-A-Z0-9+&@#\/%=~_|$?!:,.;]*\)|[-A-Z0-9+&@#\/%=~_|$?!:,.;])*(?:\([-A-Z0-9+&@#\/%=~_|$?!:,.;]*\)|[A-Z0-9+&@#\/%=~_|$;])))",
-                              QRegularExpression::CaseInsensitiveOption | QRegularExpression::DotMatchesEverythingOption | QRegularExpression::ExtendedPatternSyntaxOption);
-
-        auto reIt = re.globalMatch(it->text, 0, QRegularExpression::NormalMatch);
-        if (reIt.hasNext()) {
-            QList<Part> segments;
-            int previousEnd = 0;
-            while (reIt.hasNext()) {
-                auto reMatch = reIt.next();
-                Part prefix = { it->text.mid(previousEnd, reMatch.capturedStart() - previousEnd) };
-                Part url = { it->text.mid(reMatch.capturedStart(), reMatch.capturedLength()) };
-                url.hyperlink = true;
-                segments.append(prefix);
-                segments.append(url);
-                previousEnd = reMatch.capturedEnd();
-            }
-            if (previousEnd < it->text.count()) {
-                Part suffix = { it->text.mid(previousEnd, it->text.count() - previousEnd) };
-                segments.append(suffix);
-            }
-            it = m_parts.erase(it);
-            for (auto &i : segments) {
-                it = m_parts.insert(it, i);
-                ++it;
-            }
+    const Data &data = *std::as_const(d);
+    QStringView text(data.text);
+    QVarLengthArray<Part, 2> parts;
+    auto appendRun = [&parts](const Part &formatting, int offset, int length, bool hyperlink) {
+        if (length <= 0)
+            return;
+        // links stay separate even when there's another one right next to them
+        if (!parts.isEmpty() && !hyperlink && !parts.last().hyperlink && parts.last().sameFormatting(formatting)) {
+            parts.last().length += length;
+            return;
         }
-        else {
-            ++it;
+        Part part = formatting;
+        part.offset = offset;
+        part.length = length;
+        part.hyperlink = formatting.hyperlink || hyperlink;
+        parts.append(part);
+    };
+    for (auto &i : data.parts) {
+        auto run = text.mid(i.offset, i.length);
+        int previousEnd = 0, start = 0, length = 0;
+        while (findUrl(run, previousEnd, &start, &length)) {
+            appendRun(i, i.offset + previousEnd, start - previousEnd, false);
+            appendRun(i, i.offset + start, length, true);
+            previousEnd = start + length;
         }
+        appendRun(i, i.offset + previousEnd, i.length - previousEnd, false);
     }
-    while (it != m_parts.end()) {
-        if (it->text.isEmpty())
-            it = m_parts.erase(it);
-        else
-            ++it;
-    }
-    it = m_parts.begin();
+    if (parts.isEmpty())
+        parts.append(Part());
+    d->parts = parts;
+    d->cacheKey = 0;
 }
 
 QStringList FormattedString::split(const QString &sep) const {
-    return toPlain().split(sep);
+    return d->text.split(sep);
 }
 
 qlonglong FormattedString::toLongLong(bool *ok, int base) const {
-    return toPlain().toLongLong(ok, base);
+    return d->text.toLongLong(ok, base);
 }
 
 QString FormattedString::toLower() const {
-    return toPlain().toLower();
+    return d->text.toLower();
 }
 
 std::string FormattedString::toStdString() const {
-    return toPlain().toStdString();
+    return d->text.toStdString();
 }
 
 int FormattedString::length() const {
-    return toPlain().length();
+    return d->text.length();
 }
 
 FormattedString &FormattedString::operator+=(const char *s) {
-    lastPart().text += s;
-    return *this;
+    return operator+=(QString(s));
 }
 
 bool FormattedString::operator!=(const FormattedString &o) {
@@ -277,19 +427,52 @@ bool FormattedString::operator!=(const FormattedString &o) {
 }
 
 bool FormattedString::operator==(const FormattedString &o) {
-    return toPlain() == o.toPlain();
+    return d->text == o.d->text;
 }
 
 FormattedString::operator QString() const {
-    return toPlain();
+    return d->text;
 }
 
 FormattedString &FormattedString::operator=(QString &&o) {
-    m_parts = { std::move(o) };
-    return *this;
+    return *this = FormattedString(std::move(o));
 }
 
 FormattedString &FormattedString::operator=(const QString &o) {
-    m_parts = { o };
-    return *this;
+    return *this = FormattedString(o);
+}
+
+// the format on disk is a list of parts, each carrying its own text
+QDataStream &operator<<(QDataStream &s, const FormattedString &str) {
+    s << quint32(str.d->parts.count());
+    for (auto &i : str.d->parts) {
+        quint8 flags = (i.hyperlink ? 1 << 0 : 0) | (i.bold ? 1 << 1 : 0) | (i.underline ? 1 << 2 : 0) | (i.italic ? 1 << 3 : 0) |
+                       (i.foreground.extended ? 1 << 4 : 0) | (i.background.extended ? 1 << 5 : 0);
+        s << str.d->text.mid(i.offset, i.length) << qint32(i.foreground.index) << qint32(i.background.index) << flags;
+    }
+    return s;
+}
+
+QDataStream &operator>>(QDataStream &s, FormattedString &str) {
+    quint32 count = 0;
+    s >> count;
+    str.clear();
+    for (quint32 i = 0; i < count && s.status() == QDataStream::Ok; i++) {
+        QString text;
+        qint32 foreground = -1, background = -1;
+        quint8 flags = 0;
+        s >> text >> foreground >> background >> flags;
+        FormattedString::Part part;
+        part.foreground.index = foreground;
+        part.background.index = background;
+        part.hyperlink = flags & (1 << 0);
+        part.bold = flags & (1 << 1);
+        part.underline = flags & (1 << 2);
+        part.italic = flags & (1 << 3);
+        part.foreground.extended = flags & (1 << 4);
+        part.background.extended = flags & (1 << 5);
+        str.addPart(part);
+        str += text;
+    }
+    return s;
 }
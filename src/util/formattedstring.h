@@ -20,34 +20,50 @@
 #include <QObject>
 #include <QString>
 #include <QList>
+#include <QDataStream>
+#include <QSharedData>
+#include <QVarLengthArray>
 
 #include "colortheme.h"
 
+/*
+ * The text is kept in a single buffer, Parts are just runs of formatting over it.
+ * The data is implicitly shared so passing the strings around by value doesn't copy anything.
+ */
 class FormattedString {
     Q_GADGET
     Q_PROPERTY(int length READ length CONSTANT)
 public:
     struct Part {
         struct Color {
-            int32_t index { -1 };
+            int16_t index { -1 };
             bool extended { false };
         };
 
-        Part(const QString &text) : text(text) {}
+        Part() : hyperlink(false), bold(false), underline(false), italic(false) {}
         bool containsHtml() const { return foreground.index >= 0 || background.index >= 0 || hyperlink || bold || underline || italic; }
-        QString toHtml(const ColorTheme &theme) const;
-
-        QString text {};
+        bool sameFormatting(const Part &o) const;
+        QString toHtml(QStringView text, const ColorTheme &theme) const;
+        // color of the text in the theme, only meaningful if there's a foreground set
+        QRgb foregroundColor(const ColorTheme &theme) const;
+        // the text as it should be shown, long URLs get shortened according to the settings
+        QString displayText(QStringView text) const;
+        // same with the URL length threshold passed in, <= 0 means no shortening. Safe to call from any thread
+        QString displayText(QStringView text, int urlThreshold) const;
+
+        // position in the text of the string
+        int32_t offset { 0 };
+        int32_t length { 0 };
         Color foreground { -1, false };
         Color background { -1, false };
-        bool hyperlink { false };
-        bool bold { false };
-        bool underline { false };
-        bool italic { false };
+        bool hyperlink : 1;
+        bool bold : 1;
+        bool underline : 1;
+        bool italic : 1;
     };
 
     FormattedString();
-    FormattedString(const char *d);
+    FormattedString(const char *o);
     FormattedString(const QString &o);
     FormattedString(QString &&o);
 
@@ -76,11 +92,15 @@ public:
 
     void clear();
 
-    Part &addPart(const Part &p = {{}});
+    // starts a new run with the formatting of p at the end of the text
+    Part &addPart(const Part &p = {});
     Part &lastPart();
-    // prune would potentially (not 100% done) remove all empty parts and merge the ones with the same formatting
+    // removes empty parts, merges the neighboring ones with the same formatting and marks URLs as hyperlinks
     void prune();
+    // finds the first URL in text starting at from
+    static bool findUrl(QStringView text, int from, int *start, int *length);
 
+    const QVarLengthArray<Part, 2> &parts() const { return d->parts; }
     // QString compatibility wrappers
     QStringList split(const QString &sep) const;
     qlonglong toLongLong(bool *ok = nullptr, int base = 10) const;
@@ -89,9 +109,33 @@ public:
     int length() const;
 
 private:
-    QList<Part> m_parts {};
+    friend QDataStream &operator<<(QDataStream &s, const FormattedString &str);
+    friend QDataStream &operator>>(QDataStream &s, FormattedString &str);
+
+    struct Data : public QSharedData {
+        Data() = default;
+        // a detached copy is about to be modified, it doesn't get the key of the original
+        Data(const Data &o) : QSharedData(o), text(o.text), parts(o.parts) {}
+
+        QString text {};
+        // there's always at least one part, most strings have just one or two
+        QVarLengthArray<Part, 2> parts {};
+        // identifies the content in the HTML cache, all copies share it and every modification resets it
+        mutable quint64 cacheKey { 0 };
+    };
+    static const QSharedDataPointer<Data> &emptyData();
+
+    QString cachedHtml(int n, const ColorTheme &theme) const;
+    QString renderHtml(const ColorTheme &theme) const;
+    QString renderTrimmedHtml(int n, const ColorTheme &theme) const;
+
+    QSharedDataPointer<Data> d;
 };
 
+// used to store the strings on disk, keeps the formatting
+QDataStream &operator<<(QDataStream &s, const FormattedString &str);
+QDataStream &operator>>(QDataStream &s, FormattedString &str);
+
 Q_DECLARE_METATYPE(FormattedString)
 
 #endif // FORMATTEDSTRING_H
@@ -0,0 +1,105 @@
+// Lith
+// Copyright (C) 2021 Martin Bříza
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+#include "framescheduler.h"
+
+#include <QGuiApplication>
+#include <QQuickItem>
+#include <QQuickWindow>
+
+// long enough to never fire before the next frame of a window that's being rendered
+static const int c_fallbackIntervalMsecs = 50;
+
+namespace {
+// flushes the scheduler when it gets polished, the window does that before the frame gets synchronized
+class FlushItem : public QQuickItem {
+public:
+    FlushItem(FrameScheduler *scheduler, QQuickItem *parent)
+        : QQuickItem(parent)
+        , m_scheduler(scheduler)
+    {}
+
+protected:
+    void updatePolish() override {
+        if (m_scheduler)
+            m_scheduler->flush();
+    }
+
+private:
+    QPointer<FrameScheduler> m_scheduler;
+};
+}
+
+FrameScheduler::FrameScheduler(QObject *parent)
+    : QObject(parent)
+{
+    m_fallbackTimer.setSingleShot(true);
+    m_fallbackTimer.setInterval(c_fallbackIntervalMsecs);
+    connect(&m_fallbackTimer, &QTimer::timeout, this, &FrameScheduler::flush);
+}
+
+void FrameScheduler::request() {
+    m_statistics.updates++;
+    if (m_pending++ > 0)
+        return;
+    // polishing asks for a frame too, in case nothing else is changing on the screen
+    auto w = window();
+    if (w && w->isExposed() && m_item)
+        m_item->polish();
+    m_fallbackTimer.start();
+}
+
+void FrameScheduler::flush() {
+    if (m_pending == 0)
+        return;
+    m_fallbackTimer.stop();
+    m_statistics.flushes++;
+    m_statistics.lastFlush = m_pending;
+    m_statistics.largestFlush = qMax(m_statistics.largestFlush, m_pending);
+    // updates queued from the handlers wait for the next frame
+    m_pending = 0;
+    emit frame();
+}
+
+const FrameScheduler::Statistics &FrameScheduler::statistics() const {
+    return m_statistics;
+}
+
+QVariantMap FrameScheduler::statisticsMap() const {
+    return {
+        { "flushes", m_statistics.flushes },
+        { "updates", m_statistics.updates },
+        { "lastFlush", m_statistics.lastFlush },
+        { "largestFlush", m_statistics.largestFlush },
+        // the updates still waiting haven't been part of any flush yet
+        { "averageFlush", m_statistics.flushes ? double(m_statistics.updates - m_pending) / m_statistics.flushes : 0.0 }
+    };
+}
+
+QQuickWindow *FrameScheduler::window() {
+    // the QML engine creates the window after Lith already exists, look for it once it's there
+    if (!m_window) {
+        for (auto w : QGuiApplication::allWindows()) {
+            m_window = qobject_cast<QQuickWindow*>(w);
+            if (m_window) {
+                // items are polished on the GUI thread with both the basic and the threaded render loop
+                m_item = new FlushItem(this, m_window->contentItem());
+                break;
+            }
+        }
+    }
+    return m_window;
+}
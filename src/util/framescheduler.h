@@ -0,0 +1,74 @@
+// Lith
+// Copyright (C) 2021 Martin Bříza
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QVariantMap>
+
+class QQuickItem;
+class QQuickWindow;
+
+/*
+ * Coalesces model updates arriving in bursts into a single flush per frame.
+ *
+ * Every queued update calls request(), frame() is then emitted once when the window polishes its
+ * items for the next frame, from an invisible item of its own. The views lay themselves out in the
+ * same pass, so all updates queued in the meantime show up in that frame. When the window isn't
+ * being rendered (minimized, not created yet), a timer flushes at a slower pace instead.
+ * Only to be used from the GUI thread.
+ */
+class FrameScheduler : public QObject {
+    Q_OBJECT
+public:
+    struct Statistics {
+        // frames that flushed something
+        quint64 flushes { 0 };
+        // updates queued in total
+        quint64 updates { 0 };
+        // updates flushed in the last and the busiest frame
+        int lastFlush { 0 };
+        int largestFlush { 0 };
+    };
+
+    FrameScheduler(QObject *parent = nullptr);
+
+    // notes one more update waiting for the next frame
+    void request();
+    // emits frame() right away if anything is waiting
+    void flush();
+
+    const Statistics &statistics() const;
+    QVariantMap statisticsMap() const;
+
+signals:
+    void frame();
+
+private:
+    QQuickWindow *window();
+
+    QPointer<QQuickWindow> m_window {};
+    // polished whenever there's something to flush
+    QPointer<QQuickItem> m_item {};
+    QTimer m_fallbackTimer {};
+    int m_pending { 0 };
+    Statistics m_statistics {};
+};
+
+#endif // FRAMESCHEDULER_H
@@ -0,0 +1,128 @@
+// Lith
+// Copyright (C) 2021 Martin Bříza
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HDATABINDING_H
+#define HDATABINDING_H
+
+#include "protocol.h"
+
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+/*
+ * USAGE:
+ * every type filled from HData gets a constexpr table of HDATA_BIND entries
+ * mapping the HData keys to its setters, keys with a null setter are known but ignored.
+ * The keys of a message are resolved once, then every item is applied without
+ * touching the meta-object system. Keys missing in the table are only counted.
+ */
+#define HDATA_BIND(type, name) \
+    { STRINGIFY(name), [](type *o, const QVariant &v) { \
+        o->name ## Set(qvariant_cast<std::decay_t<decltype(o->name ## Get())>>(v)); \
+    } }
+
+#define HDATA_BIND_AS(type, key, name) \
+    { key, [](type *o, const QVariant &v) { \
+        o->name ## Set(qvariant_cast<std::decay_t<decltype(o->name ## Get())>>(v)); \
+    } }
+
+#define HDATA_IGNORE(key) \
+    { key, nullptr }
+
+template <typename T>
+class HDataBinding {
+public:
+    using Setter = void (*)(T *object, const QVariant &value);
+    struct Entry {
+        const char *key;
+        Setter setter;
+    };
+
+    // setters for the keys of a single message, in the order in which they're stored in its items
+    class Resolved {
+    public:
+        void apply(T *object, const Protocol::HData::Item &item) const {
+            if (item.objects.count() != m_setters.count()) {
+                // shouldn't happen, all items of a message have the same keys
+                for (auto it = item.objects.cbegin(); it != item.objects.cend(); ++it)
+                    m_binding->applyOne(object, it.key(), it.value());
+                return;
+            }
+            auto it = item.objects.cbegin();
+            for (auto setter : m_setters) {
+                if (!setter)
+                    s_unknownKeys++;
+                else if (setter != &ignore)
+                    setter(object, it.value());
+                ++it;
+            }
+        }
+    private:
+        friend class HDataBinding;
+        const HDataBinding *m_binding { nullptr };
+        QList<Setter> m_setters {};
+    };
+
+    template <size_t N>
+    constexpr HDataBinding(const Entry (&entries)[N])
+        : m_entries(entries)
+        , m_count(N)
+    {}
+
+    Resolved resolve(const Protocol::HData &hda) const {
+        Resolved r;
+        r.m_binding = this;
+        if (hda.data.isEmpty())
+            return r;
+        const auto &objects = hda.data.first().objects;
+        r.m_setters.reserve(objects.count());
+        for (auto it = objects.cbegin(); it != objects.cend(); ++it)
+            r.m_setters.append(find(it.key()));
+        return r;
+    }
+
+    void applyOne(T *object, const QString &key, const QVariant &value) const {
+        auto setter = find(key);
+        if (!setter)
+            s_unknownKeys++;
+        else if (setter != &ignore)
+            setter(object, value);
+    }
+
+    static int unknownKeyCount() {
+        return s_unknownKeys;
+    }
+
+private:
+    static void ignore(T *, const QVariant &) {}
+
+    Setter find(const QString &key) const {
+        auto latin = key.toLatin1();
+        for (size_t i = 0; i < m_count; i++) {
+            if (strcmp(m_entries[i].key, latin.constData()) == 0)
+                return m_entries[i].setter ? m_entries[i].setter : &ignore;
+        }
+        return nullptr;
+    }
+
+    const Entry *m_entries;
+    size_t m_count;
+
+    inline static std::atomic<int> s_unknownKeys { 0 };
+};
+
+#endif // HDATABINDING_H
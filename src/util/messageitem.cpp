@@ -0,0 +1,259 @@
+// Lith
+// Copyright (C) 2021 Martin Bříza
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+#include "messageitem.h"
+
+#include "lith.h"
+
+#include <QPainter>
+#include <QCursor>
+#include <QMouseEvent>
+#include <QtMath>
+
+// how many widths of the line are kept laid out
+static const int c_cachedLayouts = 4;
+
+// FormattedString only compares the text, a line that just got recolored has to be laid out again
+static bool identical(const FormattedString &a, const FormattedString &b) {
+    if (a.toPlain() != b.toPlain() || a.parts().count() != b.parts().count())
+        return false;
+    for (int i = 0; i < a.parts().count(); i++) {
+        auto &x = a.parts()[i];
+        auto &y = b.parts()[i];
+        if (x.offset != y.offset || x.length != y.length || !x.sameFormatting(y))
+            return false;
+    }
+    return true;
+}
+
+MessageItem::MessageItem(QQuickItem *parent)
+    : QQuickPaintedItem(parent)
+{
+    setAcceptHoverEvents(true);
+    setAcceptedMouseButtons(Qt::LeftButton);
+    connect(Lith::instance(), &Lith::renderGenerationChanged, this, &MessageItem::invalidateContent);
+}
+
+MessageItem::~MessageItem() {
+}
+
+QString MessageItem::timestampGet() const {
+    return m_timestamp;
+}
+
+void MessageItem::timestampSet(const QString &o) {
+    if (m_timestamp != o) {
+        m_timestamp = o;
+        emit timestampChanged();
+        invalidateContent();
+    }
+}
+
+FormattedString MessageItem::prefixGet() const {
+    return m_prefix;
+}
+
+void MessageItem::prefixSet(const FormattedString &o) {
+    if (!identical(m_prefix, o)) {
+        m_prefix = o;
+        emit prefixChanged();
+        invalidateContent();
+    }
+}
+
+FormattedString MessageItem::messageGet() const {
+    return m_message;
+}
+
+void MessageItem::messageSet(const FormattedString &o) {
+    if (!identical(m_message, o)) {
+        m_message = o;
+        emit messageChanged();
+        invalidateContent();
+    }
+}
+
+int MessageItem::prefixLengthGet() const {
+    return m_prefixLength;
+}
+
+void MessageItem::prefixLengthSet(int o) {
+    if (m_prefixLength != o) {
+        m_prefixLength = o;
+        emit prefixLengthChanged();
+        invalidateContent();
+    }
+}
+
+QFont MessageItem::fontGet() const {
+    return m_font;
+}
+
+void MessageItem::fontSet(const QFont &o) {
+    if (m_font != o) {
+        m_font = o;
+        emit fontChanged();
+        invalidateContent();
+    }
+}
+
+QColor MessageItem::colorGet() const {
+    return m_color;
+}
+
+void MessageItem::colorSet(const QColor &o) {
+    if (m_color != o) {
+        m_color = o;
+        emit colorChanged();
+        // the pen is set when painting, layouts stay
+        update();
+    }
+}
+
+QColor MessageItem::timestampColorGet() const {
+    return m_timestampColor;
+}
+
+void MessageItem::timestampColorSet(const QColor &o) {
+    if (m_timestampColor != o) {
+        m_timestampColor = o;
+        emit timestampColorChanged();
+        update();
+    }
+}
+
+QColor MessageItem::linkColorGet() const {
+    return m_linkColor;
+}
+
+void MessageItem::linkColorSet(const QColor &o) {
+    if (m_linkColor != o) {
+        m_linkColor = o;
+        emit linkColorChanged();
+        invalidateContent();
+    }
+}
+
+QString MessageItem::hoveredLinkGet() const {
+    return m_hoveredLink;
+}
+
+QString MessageItem::linkAt(qreal x, qreal y) {
+    ensureLayout();
+    return m_layout->linkAt(QPointF(x, y));
+}
+
+void MessageItem::paint(QPainter *painter) {
+    ensureLayout();
+    m_layout->draw(painter, m_color, m_timestampColor);
+}
+
+void MessageItem::componentComplete() {
+    QQuickPaintedItem::componentComplete();
+    // all the initial bindings are in, lay the line out just once for them
+    invalidateLayout();
+}
+
+void MessageItem::geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry) {
+    QQuickPaintedItem::geometryChange(newGeometry, oldGeometry);
+    if (newGeometry.width() != oldGeometry.width())
+        invalidateLayout();
+}
+
+void MessageItem::mousePressEvent(QMouseEvent *event) {
+    m_pressedLink = linkAt(event->position().x(), event->position().y());
+    // everything but links goes to the items below
+    if (m_pressedLink.isEmpty())
+        event->ignore();
+    else
+        event->accept();
+}
+
+void MessageItem::mouseReleaseEvent(QMouseEvent *event) {
+    auto link = linkAt(event->position().x(), event->position().y());
+    if (!link.isEmpty() && link == m_pressedLink)
+        emit linkActivated(link);
+    m_pressedLink.clear();
+}
+
+void MessageItem::hoverMoveEvent(QHoverEvent *event) {
+    setHoveredLink(linkAt(event->position().x(), event->position().y()));
+    QQuickPaintedItem::hoverMoveEvent(event);
+}
+
+void MessageItem::hoverLeaveEvent(QHoverEvent *event) {
+    setHoveredLink(QString());
+    QQuickPaintedItem::hoverLeaveEvent(event);
+}
+
+MessageLayout::Parameters MessageItem::parameters() const {
+    MessageLayout::Parameters result;
+    auto settings = Lith::instance()->settingsGet();
+    result.width = width();
+    result.font = m_font;
+    result.prefixLength = m_prefixLength;
+    result.linkColor = m_linkColor;
+    result.urlThreshold = settings->shortenLongUrlsGet() ? settings->shortenLongUrlsThresholdGet() : 0;
+    result.theme = &FormattedString::getCurrentTheme();
+    result.generation = Lith::instance()->renderGenerationGet();
+    return result;
+}
+
+void MessageItem::invalidateContent() {
+    m_layouts.clear();
+    invalidateLayout();
+}
+
+void MessageItem::invalidateLayout() {
+    m_layout.reset();
+    update();
+    // the height has to be right as soon as the delegate is created, ListView positions the next ones by it
+    if (isComponentComplete() && width() > 0)
+        ensureLayout();
+}
+
+void MessageItem::ensureLayout() {
+    if (m_layout)
+        return;
+
+    const int key = qFloor(width());
+    auto it = m_layouts.find(key);
+    if (it == m_layouts.end()) {
+        if (m_layouts.count() >= c_cachedLayouts)
+            m_layouts.clear();
+        const auto parameters = this->parameters();
+        MessageLayout::setViewParameters(parameters);
+        const MessageLayout::Input input { m_timestamp, m_prefix, m_message };
+        // lines that just arrived have likely been laid out on the thread pool already
+        auto layout = MessageLayout::find(input, parameters);
+        if (!layout)
+            layout = MessageLayout::create(input, parameters);
+        it = m_layouts.insert(key, layout);
+    }
+    m_layout = it.value();
+    setImplicitHeight(m_layout->height());
+}
+
+void MessageItem::setHoveredLink(const QString &link) {
+    if (m_hoveredLink == link)
+        return;
+    m_hoveredLink = link;
+    if (link.isEmpty())
+        unsetCursor();
+    else
+        setCursor(Qt::PointingHandCursor);
+    emit hoveredLinkChanged();
+}
@@ -0,0 +1,118 @@
+// Lith
+// Copyright (C) 2021 Martin Bříza
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef MESSAGEITEM_H
+#define MESSAGEITEM_H
+
+#include "common.h"
+#include "messagelayout.h"
+
+#include <QQuickPaintedItem>
+#include <QFont>
+#include <QColor>
+#include <QHash>
+
+#include <memory>
+
+/*
+ * Draws a single line of the buffer: the timestamp, the prefix and the message.
+ *
+ * The text is laid out by QTextLayout straight from the formatting runs of FormattedString (see MessageLayout)
+ * instead of going through HTML and a QTextDocument like a RichText Text item would.
+ * Layouts are kept for the last few widths so resizing back and forth doesn't redo them.
+ */
+class MessageItem : public QQuickPaintedItem {
+    Q_OBJECT
+    Q_PROPERTY(QString timestamp READ timestampGet WRITE timestampSet NOTIFY timestampChanged)
+    Q_PROPERTY(FormattedString prefix READ prefixGet WRITE prefixSet NOTIFY prefixChanged)
+    Q_PROPERTY(FormattedString message READ messageGet WRITE messageSet NOTIFY messageChanged)
+    // same as nickCutoffThreshold, the prefix gets trimmed and padded to this length, <= 0 shows it whole
+    Q_PROPERTY(int prefixLength READ prefixLengthGet WRITE prefixLengthSet NOTIFY prefixLengthChanged)
+    Q_PROPERTY(QFont font READ fontGet WRITE fontSet NOTIFY fontChanged)
+    Q_PROPERTY(QColor color READ colorGet WRITE colorSet NOTIFY colorChanged)
+    Q_PROPERTY(QColor timestampColor READ timestampColorGet WRITE timestampColorSet NOTIFY timestampColorChanged)
+    Q_PROPERTY(QColor linkColor READ linkColorGet WRITE linkColorSet NOTIFY linkColorChanged)
+    Q_PROPERTY(QString hoveredLink READ hoveredLinkGet NOTIFY hoveredLinkChanged)
+public:
+    MessageItem(QQuickItem *parent = nullptr);
+    ~MessageItem();
+
+    QString timestampGet() const;
+    void timestampSet(const QString &o);
+    FormattedString prefixGet() const;
+    void prefixSet(const FormattedString &o);
+    FormattedString messageGet() const;
+    void messageSet(const FormattedString &o);
+    int prefixLengthGet() const;
+    void prefixLengthSet(int o);
+    QFont fontGet() const;
+    void fontSet(const QFont &o);
+    QColor colorGet() const;
+    void colorSet(const QColor &o);
+    QColor timestampColorGet() const;
+    void timestampColorSet(const QColor &o);
+    QColor linkColorGet() const;
+    void linkColorSet(const QColor &o);
+    QString hoveredLinkGet() const;
+
+    Q_INVOKABLE QString linkAt(qreal x, qreal y);
+
+    void paint(QPainter *painter) override;
+
+signals:
+    void timestampChanged();
+    void prefixChanged();
+    void messageChanged();
+    void prefixLengthChanged();
+    void fontChanged();
+    void colorChanged();
+    void timestampColorChanged();
+    void linkColorChanged();
+    void hoveredLinkChanged();
+    void linkActivated(const QString &link);
+
+protected:
+    void componentComplete() override;
+    void geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+    void hoverMoveEvent(QHoverEvent *event) override;
+    void hoverLeaveEvent(QHoverEvent *event) override;
+
+private:
+    MessageLayout::Parameters parameters() const;
+    void invalidateContent();
+    void invalidateLayout();
+    void ensureLayout();
+    void setHoveredLink(const QString &link);
+
+    QString m_timestamp {};
+    FormattedString m_prefix {};
+    FormattedString m_message {};
+    int m_prefixLength { 0 };
+    QFont m_font {};
+    QColor m_color { Qt::black };
+    QColor m_timestampColor { Qt::gray };
+    QColor m_linkColor { Qt::blue };
+    QString m_hoveredLink {};
+    QString m_pressedLink {};
+
+    // layouts by the width they were made for
+    QHash<int, std::shared_ptr<const MessageLayout>> m_layouts {};
+    std::shared_ptr<const MessageLayout> m_layout {};
+};
+
+#endif // MESSAGEITEM_H
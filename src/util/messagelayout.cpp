@@ -0,0 +1,216 @@
+// Lith
+// Copyright (C) 2021 Martin Bříza
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+#include "messagelayout.h"
+
+#include <QPainter>
+#include <QCache>
+#include <QMutex>
+#include <QThreadPool>
+#include <QtMath>
+
+namespace {
+struct CacheEntry {
+    MessageLayout::Input input;
+    MessageLayout::Parameters parameters;
+    std::shared_ptr<const MessageLayout> layout;
+};
+}
+
+// precomputed layouts, written by the thread pool and read by the GUI thread
+static QMutex s_cacheMutex;
+static QCache<size_t, CacheEntry> s_cache(4000);
+// only touched from the GUI thread
+static MessageLayout::Parameters s_viewParameters;
+
+bool MessageLayout::Parameters::isValid() const {
+    return width > 0.0 && theme;
+}
+
+bool MessageLayout::Parameters::operator==(const Parameters &o) const {
+    return qFloor(width) == qFloor(o.width) && font == o.font && prefixLength == o.prefixLength && linkColor == o.linkColor &&
+           urlThreshold == o.urlThreshold && theme == o.theme && generation == o.generation;
+}
+
+bool MessageLayout::Parameters::operator!=(const Parameters &o) const {
+    return !operator==(o);
+}
+
+std::shared_ptr<const MessageLayout> MessageLayout::create(const Input &input, const Parameters &parameters) {
+    std::shared_ptr<MessageLayout> result(new MessageLayout);
+    result->m_prefixContent = prepare(input.prefix, parameters.prefixLength, parameters);
+    result->m_messageContent = prepare(input.message, -1, parameters);
+
+    QFont bold = parameters.font;
+    bold.setBold(true);
+    Content timestamp { input.timestamp.isEmpty() ? QString() : input.timestamp + QChar(0x00A0) };
+    result->m_timestampLayout.reset(layoutFor(timestamp, parameters.font, -1.0));
+    result->m_prefixLayout.reset(layoutFor(result->m_prefixContent, bold, -1.0));
+    result->m_timestampWidth = result->m_timestampLayout->lineAt(0).horizontalAdvance();
+    result->m_messageX = result->m_timestampWidth + result->m_prefixLayout->lineAt(0).horizontalAdvance();
+    const int messageWidth = qMax(1, qFloor(parameters.width - result->m_messageX));
+    result->m_messageLayout.reset(layoutFor(result->m_messageContent, parameters.font, messageWidth));
+
+    result->m_height = qMax(result->m_timestampLayout->boundingRect().height(), result->m_prefixLayout->boundingRect().height());
+    result->m_height = qMax(result->m_height, result->m_messageLayout->boundingRect().height());
+    return result;
+}
+
+std::shared_ptr<const MessageLayout> MessageLayout::find(const Input &input, const Parameters &parameters) {
+    QMutexLocker locker(&s_cacheMutex);
+    auto entry = s_cache.object(key(input, parameters));
+    // the key is just a hash, make sure it's really the same line
+    if (entry && entry->parameters == parameters && entry->input.timestamp == input.timestamp &&
+        entry->input.prefix.toPlain() == input.prefix.toPlain() && entry->input.message.toPlain() == input.message.toPlain())
+        return entry->layout;
+    return nullptr;
+}
+
+void MessageLayout::precompute(const QList<Input> &inputs) {
+    const auto parameters = s_viewParameters;
+    if (!parameters.isValid() || inputs.isEmpty())
+        return;
+    QThreadPool::globalInstance()->start([inputs, parameters]() {
+        for (auto &i : inputs) {
+            auto layout = create(i, parameters);
+            QMutexLocker locker(&s_cacheMutex);
+            s_cache.insert(key(i, parameters), new CacheEntry { i, parameters, layout });
+        }
+    });
+}
+
+void MessageLayout::setViewParameters(const Parameters &parameters) {
+    if (s_viewParameters != parameters)
+        s_viewParameters = parameters;
+}
+
+qreal MessageLayout::height() const {
+    return m_height;
+}
+
+QString MessageLayout::linkAt(const QPointF &pos) const {
+    if (pos.x() >= m_messageX)
+        return linkIn(m_messageLayout.get(), m_messageContent, pos - QPointF(m_messageX, 0.0));
+    if (pos.x() >= m_timestampWidth)
+        return linkIn(m_prefixLayout.get(), m_prefixContent, pos - QPointF(m_timestampWidth, 0.0));
+    return QString();
+}
+
+void MessageLayout::draw(QPainter *painter, const QColor &color, const QColor &timestampColor) const {
+    painter->setPen(timestampColor);
+    m_timestampLayout->draw(painter, QPointF(0.0, 0.0));
+    painter->setPen(color);
+    m_prefixLayout->draw(painter, QPointF(m_timestampWidth, 0.0));
+    m_messageLayout->draw(painter, QPointF(m_messageX, 0.0));
+}
+
+MessageLayout::Content MessageLayout::prepare(const FormattedString &str, int trim, const Parameters &parameters) {
+    Content result;
+    const auto plain = str.toPlain();
+    int remaining = trim;
+    for (auto &part : str.parts()) {
+        auto run = QStringView(plain).mid(part.offset, part.length);
+        if (trim > 0)
+            run = run.left(remaining);
+
+        auto shown = part.displayText(run, parameters.urlThreshold);
+        QTextLayout::FormatRange range;
+        range.start = result.text.size();
+        range.length = shown.size();
+        // the same subset of formatting Part::toHtml produces
+        if (part.foreground.index >= 0)
+            range.format.setForeground(QColor(part.foregroundColor(*parameters.theme)));
+        if (part.bold)
+            range.format.setFontWeight(QFont::Bold);
+        if (part.underline)
+            range.format.setFontUnderline(true);
+        if (part.hyperlink) {
+            range.format.setForeground(parameters.linkColor);
+            range.format.setFontUnderline(true);
+            range.format.setAnchor(true);
+            range.format.setAnchorHref(run.toString());
+            result.links.append({ range.start, range.length, run.toString() });
+        }
+        if (!range.format.properties().isEmpty())
+            result.formats.append(range);
+        result.text.append(shown);
+
+        if (trim > 0) {
+            remaining -= run.size();
+            if (remaining <= 0)
+                break;
+        }
+    }
+    if (trim > 0)
+        result.text.append(QString(qMax(remaining, 0) + 1, QChar(0x00A0)));
+    return result;
+}
+
+QTextLayout *MessageLayout::layoutFor(const Content &content, const QFont &font, qreal width) {
+    // negative width means a single line that doesn't wrap
+    auto layout = new QTextLayout(content.text, font);
+    QTextOption option;
+    option.setWrapMode(width < 0.0 ? QTextOption::NoWrap : QTextOption::WrapAtWordBoundaryOrAnywhere);
+    layout->setTextOption(option);
+    layout->setFormats(content.formats);
+    layout->setCacheEnabled(true);
+    layout->beginLayout();
+    qreal height = 0.0;
+    while (true) {
+        auto line = layout->createLine();
+        if (!line.isValid())
+            break;
+        if (width >= 0.0)
+            line.setLineWidth(width);
+        line.setPosition(QPointF(0.0, height));
+        height += line.height();
+    }
+    layout->endLayout();
+    return layout;
+}
+
+QString MessageLayout::linkIn(const QTextLayout *layout, const Content &content, const QPointF &pos) {
+    if (!layout || content.links.isEmpty())
+        return QString();
+    for (int i = 0; i < layout->lineCount(); i++) {
+        auto line = layout->lineAt(i);
+        if (pos.y() < line.y() || pos.y() >= line.y() + line.height())
+            continue;
+        if (pos.x() < line.x() || pos.x() > line.x() + line.naturalTextWidth())
+            return QString();
+        const int cursor = line.xToCursor(pos.x(), QTextLine::CursorOnCharacter);
+        for (auto &link : content.links) {
+            if (cursor >= link.start && cursor < link.start + link.length)
+                return link.url;
+        }
+        return QString();
+    }
+    return QString();
+}
+
+size_t MessageLayout::key(const Input &input, const Parameters &parameters) {
+    auto formatting = [](const FormattedString &str) {
+        size_t result = 0;
+        for (auto &i : str.parts()) {
+            result = qHashMulti(result, i.offset, i.length, i.foreground.index, i.foreground.extended, i.background.index,
+                                i.background.extended, bool(i.hyperlink), bool(i.bold), bool(i.underline), bool(i.italic));
+        }
+        return result;
+    };
+    return qHashMulti(0, input.timestamp, input.prefix.toPlain(), formatting(input.prefix), input.message.toPlain(), formatting(input.message),
+                      qFloor(parameters.width), parameters.font.key(), parameters.prefixLength, parameters.linkColor.rgba(),
+                      parameters.urlThreshold, quintptr(parameters.theme), parameters.generation);
+}
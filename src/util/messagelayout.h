@@ -0,0 +1,102 @@
+// Lith
+// Copyright (C) 2021 Martin Bříza
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef MESSAGELAYOUT_H
+#define MESSAGELAYOUT_H
+
+#include "common.h"
+
+#include <QTextLayout>
+#include <QFont>
+#include <QColor>
+
+#include <memory>
+
+class QPainter;
+
+/*
+ * Timestamp, prefix and message of a single line laid out next to each other for one width.
+ *
+ * A layout doesn't change once it's created, so it can be made ahead of time on the thread pool
+ * by precompute() for the lines that just arrived and picked up by MessageItem through find().
+ */
+class MessageLayout {
+public:
+    // everything besides the text that affects the layout
+    struct Parameters {
+        qreal width { 0.0 };
+        QFont font {};
+        int prefixLength { 0 };
+        QColor linkColor { Qt::blue };
+        // <= 0 for no URL shortening
+        int urlThreshold { 0 };
+        const ColorTheme *theme { nullptr };
+        int generation { 0 };
+
+        bool isValid() const;
+        bool operator==(const Parameters &o) const;
+        bool operator!=(const Parameters &o) const;
+    };
+    struct Input {
+        QString timestamp {};
+        FormattedString prefix {};
+        FormattedString message {};
+    };
+
+    static std::shared_ptr<const MessageLayout> create(const Input &input, const Parameters &parameters);
+
+    // a layout made by precompute() if it's ready
+    static std::shared_ptr<const MessageLayout> find(const Input &input, const Parameters &parameters);
+    // lays the lines out on the thread pool with the parameters last used by the view
+    static void precompute(const QList<Input> &inputs);
+    // MessageItem reports what it lays out with so new lines can be prepared the same way
+    static void setViewParameters(const Parameters &parameters);
+
+    qreal height() const;
+    QString linkAt(const QPointF &pos) const;
+    void draw(QPainter *painter, const QColor &color, const QColor &timestampColor) const;
+
+private:
+    struct Link {
+        int start;
+        int length;
+        QString url;
+    };
+    // the plain text with formatting ranges, made from a FormattedString
+    struct Content {
+        QString text {};
+        QList<QTextLayout::FormatRange> formats {};
+        QList<Link> links {};
+    };
+
+    MessageLayout() = default;
+
+    static Content prepare(const FormattedString &str, int trim, const Parameters &parameters);
+    static QTextLayout *layoutFor(const Content &content, const QFont &font, qreal width);
+    static QString linkIn(const QTextLayout *layout, const Content &content, const QPointF &pos);
+    static size_t key(const Input &input, const Parameters &parameters);
+
+    Content m_prefixContent {};
+    Content m_messageContent {};
+    std::unique_ptr<QTextLayout> m_timestampLayout {};
+    std::unique_ptr<QTextLayout> m_prefixLayout {};
+    std::unique_ptr<QTextLayout> m_messageLayout {};
+    qreal m_timestampWidth { 0.0 };
+    qreal m_messageX { 0.0 };
+    qreal m_height { 0.0 };
+};
+
+#endif // MESSAGELAYOUT_H
@@ -17,6 +17,7 @@
 #include "messagelistfilter.h"
 #include "datamodel.h"
 #include "lith.h"
+#include "searchindex.h"
 
 MessageFilterList::MessageFilterList(QObject *parent, QAbstractListModel *parentModel)
     : QSortFilterProxyModel(parent)
@@ -27,7 +28,40 @@ MessageFilterList::MessageFilterList(QObject *parent, QAbstractListModel *parent
     {
         invalidateFilter();
     });
+    connect(this, &MessageFilterList::filterWordChanged, [this]
+    {
+        updateMatches();
+        invalidateFilter();
+    });
+    if (parentModel) {
+        // Buffer::releaseLineModels unsets the source model while these are still connected
+        connect(parentModel, &QAbstractItemModel::rowsAboutToBeRemoved, this, [this, parentModel](const QModelIndex &parent, int first, int last) {
+            // the pointers could be reused by new lines
+            for (int i = first; i <= last; i++)
+                m_matches.remove(qvariant_cast<BufferLine*>(parentModel->data(parentModel->index(i, 0, parent))));
+        });
+        connect(parentModel, &QAbstractItemModel::modelAboutToBeReset, this, [this] {
+            m_matches.clear();
+        });
+    }
+}
+
+void MessageFilterList::updateMatches() {
+    m_words = SearchIndex::parseQuery(filterWordGet());
+    m_matches.clear();
+    if (m_words.isEmpty() || !sourceModel())
+        return;
+    auto buffer = qobject_cast<Buffer*>(this->parent());
+    for (auto &i : Lith::instance()->searchIndex()->query(filterWordGet(), 0, buffer))
+        m_matches.insert(i.line, true);
+    // everything else that's already in the buffer doesn't match, only lines added from now on need a look
+    for (int i = 0; i < sourceModel()->rowCount(); i++) {
+        auto line = qvariant_cast<BufferLine*>(sourceModel()->data(sourceModel()->index(i, 0)));
+        if (line && !m_matches.contains(line))
+            m_matches.insert(line, false);
+    }
 }
+
 bool MessageFilterList::filterAcceptsRow(int source_row, const QModelIndex &source_parent) const {
     if (!sourceModel())
         return true;
@@ -36,6 +70,14 @@ bool MessageFilterList::filterAcceptsRow(int source_row, const QModelIndex &sour
     auto v = sourceModel()->data(index);
     auto b = qvariant_cast<BufferLine*>(v);
 
+    if (b && !m_words.isEmpty()) {
+        auto it = m_matches.find(b);
+        if (it == m_matches.end())
+            it = m_matches.insert(b, SearchIndex::matches(m_words, b));
+        if (!it.value())
+            return false;
+    }
+
     if (b && !Lith::instance()->settingsGet()->showJoinPartQuitMessagesGet()) {
         return !b->isJoinPartQuitMsgGet();
     }
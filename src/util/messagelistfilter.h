@@ -20,6 +20,9 @@
 #include "common.h"
 
 #include <QSortFilterProxyModel>
+#include <QHash>
+
+class BufferLine;
 
 class MessageFilterList : public QSortFilterProxyModel {
     Q_OBJECT
@@ -28,6 +31,15 @@ public:
     MessageFilterList(QObject *parent = nullptr, QAbstractListModel *parentModel = nullptr);
 
     virtual bool filterAcceptsRow(int source_row, const QModelIndex &source_parent) const override;
+
+private:
+    void updateMatches();
+
+    // filterWord split to the words SearchIndex matches
+    QStringList m_words {};
+    // whether the lines of this buffer match filterWord, filled from Lith::searchIndex when the filter
+    // changes, lines added later are tested one by one when they're filtered
+    mutable QHash<const BufferLine*, bool> m_matches {};
 };
 
 #endif // MESSAGELISTFILTER_H
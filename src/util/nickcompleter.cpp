@@ -0,0 +1,195 @@
+// Lith
+// Copyright (C) 2021 Martin Bříza
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+#include "nickcompleter.h"
+
+#include "datamodel.h"
+
+#include <algorithm>
+
+NickCompleter::NickCompleter() {
+    clear();
+}
+
+void NickCompleter::add(const Nick *nick) {
+    if (!isCompletable(nick) || m_names.contains(nick))
+        return;
+    auto name = nick->nameGet().toPlain();
+    m_names.insert(nick, name);
+    insert(name);
+}
+
+void NickCompleter::remove(const Nick *nick) {
+    auto it = m_names.find(nick);
+    if (it == m_names.end())
+        return;
+    erase(*it);
+    m_names.erase(it);
+}
+
+void NickCompleter::update(const Nick *nick) {
+    const QString previous = m_names.value(nick);
+    const QString current = isCompletable(nick) ? nick->nameGet().toPlain() : QString();
+    if (previous == current)
+        return;
+    remove(nick);
+    add(nick);
+}
+
+void NickCompleter::clear() {
+    m_nodes.clear();
+    // the root, standing for the empty prefix
+    m_nodes.append(Node {});
+    m_free.clear();
+    m_names.clear();
+    m_count = 0;
+}
+
+void NickCompleter::noteActivity(const QString &nick, qint64 msecsSinceEpoch) {
+    int node = find(fold(nick));
+    if (node <= 0 || m_nodes[node].references <= 0)
+        return;
+    m_nodes[node].lastActivity = qMax(m_nodes[node].lastActivity, msecsSinceEpoch);
+}
+
+QStringList NickCompleter::complete(const QString &prefix, int n) const {
+    int node = find(fold(prefix));
+    if (n <= 0 || node < 0)
+        return {};
+
+    // the candidates come in alphabetical order, their position breaks the ties in activity
+    QVector<quint32> candidates;
+    collect(node, candidates);
+    QVector<int> order(candidates.count());
+    for (int i = 0; i < order.count(); i++)
+        order[i] = i;
+    const int count = qMin(n, int(order.count()));
+    std::partial_sort(order.begin(), order.begin() + count, order.end(), [this, &candidates](int a, int b) {
+        const qint64 left = m_nodes[candidates[a]].lastActivity;
+        const qint64 right = m_nodes[candidates[b]].lastActivity;
+        if (left != right)
+            return left > right;
+        return a < b;
+    });
+
+    QStringList result;
+    result.reserve(count);
+    for (int i = 0; i < count; i++)
+        result.append(m_nodes[candidates[order[i]]].name);
+    return result;
+}
+
+int NickCompleter::count() const {
+    return m_count;
+}
+
+bool NickCompleter::isCompletable(const Nick *nick) {
+    return nick && nick->visibleGet() && nick->levelGet() == 0;
+}
+
+QString NickCompleter::fold(const QString &name) {
+    return name.toCaseFolded();
+}
+
+void NickCompleter::insert(const QString &name) {
+    quint32 node = 0;
+    for (auto c : fold(name)) {
+        const auto &children = m_nodes[node].children;
+        auto it = std::lower_bound(children.begin(), children.end(), c, [](const Edge &e, QChar c) { return e.c < c; });
+        if (it != children.end() && it->c == c) {
+            node = it->node;
+            continue;
+        }
+        const int position = it - children.begin();
+        // allocating may move the nodes around, the edge is added only after that
+        const quint32 child = allocate();
+        auto &parentChildren = m_nodes[node].children;
+        parentChildren.insert(parentChildren.begin() + position, Edge { c, child });
+        node = child;
+    }
+    auto &terminal = m_nodes[node];
+    // two nicks can differ only in case, the one that came first is shown
+    if (terminal.references++ == 0) {
+        terminal.name = name;
+        m_count++;
+    }
+}
+
+void NickCompleter::erase(const QString &name) {
+    QVarLengthArray<quint32, 32> path;
+    path.append(0);
+    for (auto c : fold(name)) {
+        const auto &children = m_nodes[path.last()].children;
+        auto it = std::lower_bound(children.begin(), children.end(), c, [](const Edge &e, QChar c) { return e.c < c; });
+        if (it == children.end() || it->c != c)
+            return;
+        path.append(it->node);
+    }
+    auto &terminal = m_nodes[path.last()];
+    if (terminal.references <= 0 || --terminal.references > 0)
+        return;
+    terminal.name.clear();
+    terminal.lastActivity = 0;
+    m_count--;
+
+    // drop the branch that doesn't lead to any nick anymore
+    for (int i = path.count() - 1; i > 0; i--) {
+        const quint32 node = path[i];
+        if (!m_nodes[node].children.isEmpty() || m_nodes[node].references > 0)
+            break;
+        auto &children = m_nodes[path[i - 1]].children;
+        for (int j = 0; j < children.count(); j++) {
+            if (children[j].node == node) {
+                children.remove(j);
+                break;
+            }
+        }
+        m_nodes[node] = Node {};
+        m_free.append(node);
+    }
+}
+
+int NickCompleter::find(const QString &folded) const {
+    quint32 node = 0;
+    for (auto c : folded) {
+        const auto &children = m_nodes[node].children;
+        auto it = std::lower_bound(children.begin(), children.end(), c, [](const Edge &e, QChar c) { return e.c < c; });
+        if (it == children.end() || it->c != c)
+            return -1;
+        node = it->node;
+    }
+    return node;
+}
+
+quint32 NickCompleter::allocate() {
+    if (!m_free.isEmpty())
+        return m_free.takeLast();
+    m_nodes.append(Node {});
+    return m_nodes.count() - 1;
+}
+
+void NickCompleter::collect(quint32 node, QVector<quint32> &result) const {
+    // depth first, the children are pushed in reverse so they come out in alphabetical order
+    QVector<quint32> stack { node };
+    while (!stack.isEmpty()) {
+        const quint32 current = stack.takeLast();
+        if (m_nodes[current].references > 0)
+            result.append(current);
+        const auto &children = m_nodes[current].children;
+        for (auto it = children.rbegin(); it != children.rend(); ++it)
+            stack.append(it->node);
+    }
+}
@@ -0,0 +1,85 @@
+// Lith
+// Copyright (C) 2021 Martin Bříza
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef NICKCOMPLETER_H
+#define NICKCOMPLETER_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVarLengthArray>
+#include <QVector>
+
+class Nick;
+
+/*
+ * Tab completion candidates of a single buffer.
+ *
+ * The visible nicks are kept in a trie of their case folded names, the buffer updates it whenever
+ * its nicklist changes. Every nick remembers when it last spoke, so the completions of a prefix come
+ * out with the most recently active nicks first and alphabetically after that.
+ * Only to be used from the GUI thread.
+ */
+class NickCompleter {
+public:
+    NickCompleter();
+
+    // nicks that aren't visible or are groups are ignored, same as in the nick list
+    void add(const Nick *nick);
+    void remove(const Nick *nick);
+    // to be called after the nick's fields were changed in place
+    void update(const Nick *nick);
+    void clear();
+
+    // records that the nick said something at the time, older times than the last known are ignored
+    void noteActivity(const QString &nick, qint64 msecsSinceEpoch);
+
+    // up to n nicks starting with the prefix, case insensitive
+    QStringList complete(const QString &prefix, int n) const;
+    int count() const;
+
+private:
+    struct Edge {
+        QChar c;
+        quint32 node;
+    };
+    struct Node {
+        // sorted by the character
+        QVarLengthArray<Edge, 2> children {};
+        // the name as shown, set on the nodes where a nick ends
+        QString name {};
+        int references { 0 };
+        qint64 lastActivity { 0 };
+    };
+
+    static bool isCompletable(const Nick *nick);
+    static QString fold(const QString &name);
+
+    void insert(const QString &name);
+    void erase(const QString &name);
+    // the node the folded string leads to, -1 if there's none
+    int find(const QString &folded) const;
+    quint32 allocate();
+    void collect(quint32 node, QVector<quint32> &result) const;
+
+    QVector<Node> m_nodes {};
+    QVector<quint32> m_free {};
+    // the names the nicks were added under, to find them again once they changed
+    QHash<const Nick*, QString> m_names {};
+    int m_count { 0 };
+};
+
+#endif // NICKCOMPLETER_H
@@ -17,26 +17,268 @@
 #include "nicklistfilter.h"
 #include "datamodel.h"
 
+#include <algorithm>
+#include <functional>
+
+// batches bigger than this are sorted at once and reported as a reset instead of row by row
+static const int c_batchResetThreshold = 64;
+
+bool NickListFilter::Key::operator<(const Key &o) const {
+    if (rank != o.rank)
+        return rank < o.rank;
+    if (folded != o.folded)
+        return folded < o.folded;
+    return std::less<const Nick*>()(nick, o.nick);
+}
+
 NickListFilter::NickListFilter(QObject *parent)
-    : QSortFilterProxyModel(parent)
+    : QAbstractListModel(parent)
 {
-    setSourceModel(nullptr);
-    setFilterRole(Qt::UserRole);
-    connect(this, &NickListFilter::filterWordChanged, [this] {
-        setFilterFixedString(filterWordGet());
-    });
-}
-
-bool NickListFilter::filterAcceptsRow(int source_row, const QModelIndex &source_parent) const {
-    if (!sourceModel())
-        return false;
-    auto index = sourceModel()->index(source_row, 0, source_parent);
-    auto v = sourceModel()->data(index);
-    auto n = qvariant_cast<Nick*>(v);
-    if (n) {
-        return n->visibleGet() &&
-               n->levelGet() == 0 &&
-               n->nameGet().toLower().contains(filterWordGet().toLower());
-    }
-    return false;
+    connect(this, &NickListFilter::filterWordChanged, this, &NickListFilter::onFilterWordChanged);
+}
+
+void NickListFilter::setSourceModel(QAbstractItemModel *model) {
+    if (m_source == model)
+        return;
+    beginResetModel();
+    if (m_source)
+        disconnect(m_source, nullptr, this, nullptr);
+    m_source = model;
+    if (m_source) {
+        connect(m_source, &QAbstractItemModel::rowsInserted, this, &NickListFilter::onRowsInserted);
+        connect(m_source, &QAbstractItemModel::rowsAboutToBeRemoved, this, &NickListFilter::onRowsAboutToBeRemoved);
+        connect(m_source, &QAbstractItemModel::dataChanged, this, &NickListFilter::onDataChanged);
+        connect(m_source, &QAbstractItemModel::modelAboutToBeReset, this, &NickListFilter::onModelAboutToBeReset);
+        connect(m_source, &QAbstractItemModel::modelReset, this, &NickListFilter::onModelReset);
+    }
+    collectKeys();
+    fillRows();
+    endResetModel();
+}
+
+QAbstractItemModel *NickListFilter::sourceModel() const {
+    return m_source;
+}
+
+int NickListFilter::rowCount(const QModelIndex &parent) const {
+    if (parent.isValid())
+        return 0;
+    return m_rows.count();
+}
+
+QVariant NickListFilter::data(const QModelIndex &index, int role) const {
+    Q_UNUSED(role);
+    if (index.row() < 0 || index.row() >= m_rows.count())
+        return QVariant();
+    return QVariant::fromValue(static_cast<QObject*>(m_rows[index.row()].nick));
+}
+
+QHash<int, QByteArray> NickListFilter::roleNames() const {
+    return { { Qt::UserRole, "modelData" } };
+}
+
+void NickListFilter::onFilterWordChanged() {
+    auto folded = filterWordGet().toCaseFolded();
+    if (folded == m_foldedFilter)
+        return;
+    // a longer filter only takes rows away, the rest of them stays sorted
+    const bool refining = folded.startsWith(m_foldedFilter);
+    m_foldedFilter = folded;
+    beginResetModel();
+    if (refining) {
+        m_rows.erase(std::remove_if(m_rows.begin(), m_rows.end(), [this](const Key &key) { return !matches(key); }), m_rows.end());
+    }
+    else {
+        fillRows();
+    }
+    endResetModel();
+}
+
+void NickListFilter::onRowsInserted(const QModelIndex &parent, int first, int last) {
+    if (parent.isValid())
+        return;
+    if (last - first + 1 > c_batchResetThreshold) {
+        beginResetModel();
+        for (int i = first; i <= last; i++) {
+            auto nick = nickAt(i);
+            if (isListed(nick))
+                m_keys.insert(nick, keyOf(nick));
+        }
+        fillRows();
+        endResetModel();
+        return;
+    }
+    for (int i = first; i <= last; i++)
+        insertNick(nickAt(i));
+}
+
+void NickListFilter::onRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last) {
+    if (parent.isValid())
+        return;
+    if (last - first + 1 > c_batchResetThreshold) {
+        beginResetModel();
+        for (int i = first; i <= last; i++)
+            m_keys.remove(nickAt(i));
+        fillRows();
+        endResetModel();
+        return;
+    }
+    for (int i = first; i <= last; i++)
+        removeNick(nickAt(i));
+}
+
+void NickListFilter::onDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+    for (int i = topLeft.row(); i <= bottomRight.row(); i++)
+        updateNick(nickAt(i));
+}
+
+void NickListFilter::onModelAboutToBeReset() {
+    // the nicks are about to be deleted, don't keep them around until the reset finishes
+    beginResetModel();
+    m_keys.clear();
+    m_rows.clear();
+}
+
+void NickListFilter::onModelReset() {
+    collectKeys();
+    fillRows();
+    endResetModel();
+}
+
+bool NickListFilter::isListed(const Nick *nick) {
+    return nick && nick->visibleGet() && nick->levelGet() == 0;
+}
+
+NickListFilter::Key NickListFilter::keyOf(Nick *nick) {
+    // same order as IRC channel modes
+    static const QString ranks = QStringLiteral("~&@%+");
+    const auto prefix = nick->prefixGet().trimmed();
+    int rank = prefix.isEmpty() ? -1 : ranks.indexOf(prefix[0]);
+    if (rank < 0)
+        rank = ranks.size();
+    return { rank, nick->nameGet().toPlain().toCaseFolded(), nick };
+}
+
+Nick *NickListFilter::nickAt(int sourceRow) const {
+    if (!m_source)
+        return nullptr;
+    return qobject_cast<Nick*>(qvariant_cast<QObject*>(m_source->data(m_source->index(sourceRow, 0), Qt::UserRole)));
+}
+
+bool NickListFilter::matches(const Key &key) const {
+    return m_foldedFilter.isEmpty() || key.folded.contains(m_foldedFilter);
+}
+
+int NickListFilter::lowerBound(const Key &key) const {
+    return std::lower_bound(m_rows.begin(), m_rows.end(), key) - m_rows.begin();
+}
+
+int NickListFilter::rowOf(const Key &key) const {
+    const int row = lowerBound(key);
+    if (row < m_rows.count() && m_rows[row].nick == key.nick)
+        return row;
+    return -1;
+}
+
+void NickListFilter::insertNick(Nick *nick) {
+    if (!isListed(nick) || m_keys.contains(nick))
+        return;
+    const auto key = keyOf(nick);
+    m_keys.insert(nick, key);
+    if (!matches(key))
+        return;
+    const int row = lowerBound(key);
+    beginInsertRows(QModelIndex(), row, row);
+    m_rows.insert(row, key);
+    endInsertRows();
+}
+
+void NickListFilter::removeNick(Nick *nick) {
+    auto it = m_keys.find(nick);
+    if (it == m_keys.end())
+        return;
+    const int row = rowOf(*it);
+    m_keys.erase(it);
+    if (row < 0)
+        return;
+    beginRemoveRows(QModelIndex(), row, row);
+    m_rows.remove(row);
+    endRemoveRows();
+}
+
+void NickListFilter::updateNick(Nick *nick) {
+    auto it = m_keys.find(nick);
+    if (it == m_keys.end()) {
+        insertNick(nick);
+        return;
+    }
+    if (!isListed(nick)) {
+        removeNick(nick);
+        return;
+    }
+
+    const Key previous = *it;
+    const Key current = keyOf(nick);
+    const int from = rowOf(previous);
+    if (current.rank == previous.rank && current.folded == previous.folded) {
+        // still in the same place, only something shown changed
+        if (from >= 0)
+            emit dataChanged(index(from), index(from));
+        return;
+    }
+    *it = current;
+
+    const bool shown = matches(current);
+    if (from < 0) {
+        if (shown) {
+            const int row = lowerBound(current);
+            beginInsertRows(QModelIndex(), row, row);
+            m_rows.insert(row, current);
+            endInsertRows();
+        }
+        return;
+    }
+    if (!shown) {
+        beginRemoveRows(QModelIndex(), from, from);
+        m_rows.remove(from);
+        endRemoveRows();
+        return;
+    }
+
+    // the position among the current rows, the nick itself is still at from
+    const int to = lowerBound(current);
+    if (to == from || to == from + 1) {
+        m_rows[from] = current;
+        emit dataChanged(index(from), index(from));
+        return;
+    }
+    beginMoveRows(QModelIndex(), from, from, QModelIndex(), to);
+    m_rows.remove(from);
+    const int row = to > from ? to - 1 : to;
+    m_rows.insert(row, current);
+    endMoveRows();
+    emit dataChanged(index(row), index(row));
+}
+
+void NickListFilter::collectKeys() {
+    m_keys.clear();
+    if (!m_source)
+        return;
+    const int count = m_source->rowCount();
+    m_keys.reserve(count);
+    for (int i = 0; i < count; i++) {
+        auto nick = nickAt(i);
+        if (isListed(nick))
+            m_keys.insert(nick, keyOf(nick));
+    }
+}
+
+void NickListFilter::fillRows() {
+    m_rows.clear();
+    m_rows.reserve(m_keys.count());
+    for (auto &i : m_keys) {
+        if (matches(i))
+            m_rows.append(i);
+    }
+    std::sort(m_rows.begin(), m_rows.end());
 }
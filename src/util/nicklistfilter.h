@@ -19,15 +19,74 @@
 
 #include "common.h"
 
-#include <QSortFilterProxyModel>
+#include <QAbstractListModel>
+#include <QHash>
+#include <QPointer>
+#include <QVector>
 
-class NickListFilter : public QSortFilterProxyModel {
+class Nick;
+
+/*
+ * Visible nicks of a buffer matching filterWord, sorted by their prefix (owners, admins, ops, halfops,
+ * voiced, everyone else) and then alphabetically, case insensitive.
+ *
+ * The order is maintained as the source nicklist changes: each change is a binary search followed by
+ * a single insert, remove or move of one row, so nothing gets sorted again and views get precise updates.
+ * Large batches (a whole nicklist arriving) are sorted once and reported as a reset.
+ * The case folded names are kept with the rows for the filter.
+ */
+class NickListFilter : public QAbstractListModel {
     Q_OBJECT
     PROPERTY(QString, filterWord)
 public:
     NickListFilter(QObject *parent = nullptr);
 
-    virtual bool filterAcceptsRow(int source_row, const QModelIndex &source_parent) const override;
+    void setSourceModel(QAbstractItemModel *model);
+    QAbstractItemModel *sourceModel() const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+private slots:
+    void onFilterWordChanged();
+    void onRowsInserted(const QModelIndex &parent, int first, int last);
+    void onRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last);
+    void onDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+    void onModelAboutToBeReset();
+    void onModelReset();
+
+private:
+    struct Key {
+        int rank;
+        QString folded;
+        Nick *nick;
+
+        bool operator<(const Key &o) const;
+    };
+
+    static bool isListed(const Nick *nick);
+    static Key keyOf(Nick *nick);
+    Nick *nickAt(int sourceRow) const;
+    bool matches(const Key &key) const;
+    // first row not sorted before the key
+    int lowerBound(const Key &key) const;
+    // row of the key, -1 if it's filtered out
+    int rowOf(const Key &key) const;
+
+    void insertNick(Nick *nick);
+    void removeNick(Nick *nick);
+    void updateNick(Nick *nick);
+    // keys of everything in the source, rows are then made by fillRows
+    void collectKeys();
+    void fillRows();
+
+    QPointer<QAbstractItemModel> m_source {};
+    QString m_foldedFilter {};
+    // all the listed nicks, including those that don't match the filter
+    QHash<const Nick*, Key> m_keys {};
+    // the rows as shown, in order
+    QVector<Key> m_rows {};
 };
 
 
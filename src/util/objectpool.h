@@ -0,0 +1,115 @@
+// Lith
+// Copyright (C) 2021 Martin Bříza
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef OBJECTPOOL_H
+#define OBJECTPOOL_H
+
+#include <QObject>
+#include <QList>
+#include <QVariantMap>
+
+/*
+ * USAGE:
+ * T has to be constructible from its parent and provide reset() that puts it
+ * back to the default state. Objects are handed out by acquire() and returned
+ * by release(). Only objects that never got to QML may be released, QML and QPointers
+ * would keep referring to them and show whatever they get reused for, the rest has to be deleted.
+ * The pools are emptied by clear() before the application goes away.
+ * Only to be used from the GUI thread.
+ */
+template <typename T>
+class ObjectPool {
+public:
+    struct Statistics {
+        // objects that had to be created on the heap
+        quint64 allocated { 0 };
+        // objects handed out from the pool
+        quint64 reused { 0 };
+        // objects given back to the pool
+        quint64 released { 0 };
+        // objects deleted because the pool was full
+        quint64 destroyed { 0 };
+    };
+
+    static ObjectPool &instance() {
+        static ObjectPool pool;
+        return pool;
+    }
+
+    template <typename P>
+    T *acquire(P *parent) {
+        if (m_free.isEmpty()) {
+            m_statistics.allocated++;
+            return new T(parent);
+        }
+        m_statistics.reused++;
+        auto object = m_free.takeLast();
+        object->setParent(parent);
+        return object;
+    }
+
+    void release(T *object) {
+        m_statistics.released++;
+        if (m_free.count() >= m_capacity) {
+            m_statistics.destroyed++;
+            delete object;
+            return;
+        }
+        object->setParent(nullptr);
+        object->reset();
+        m_free.append(object);
+    }
+
+    void setCapacity(int capacity) {
+        m_capacity = capacity;
+        while (m_free.count() > m_capacity) {
+            m_statistics.destroyed++;
+            delete m_free.takeLast();
+        }
+    }
+
+    // to be called from QCoreApplication::aboutToQuit, the static pool outlives the application
+    void clear() {
+        qDeleteAll(m_free);
+        m_free.clear();
+    }
+
+    const Statistics &statistics() const {
+        return m_statistics;
+    }
+
+    QVariantMap statisticsMap() const {
+        return {
+            { "allocated", m_statistics.allocated },
+            { "reused", m_statistics.reused },
+            { "released", m_statistics.released },
+            { "destroyed", m_statistics.destroyed },
+            { "pooled", m_free.count() }
+        };
+    }
+
+private:
+    ObjectPool() = default;
+    // anything left wouldn't be deleted safely anymore, see clear()
+    ~ObjectPool() = default;
+    Q_DISABLE_COPY(ObjectPool)
+
+    QList<T*> m_free {};
+    int m_capacity { 10000 };
+    Statistics m_statistics {};
+};
+
+#endif // OBJECTPOOL_H
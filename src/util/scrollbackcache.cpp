@@ -0,0 +1,292 @@
+// Lith
+// Copyright (C) 2021 Martin Bříza
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+#include "scrollbackcache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+
+static const quint32 c_magic = 0x4c495448; // "LITH"
+// 2: the stream version is fixed
+static const quint32 c_version = 2;
+// the format mustn't depend on the Qt version the application was built with
+static const QDataStream::Version c_streamVersion = QDataStream::Qt_6_2;
+
+ScrollbackCache::ScrollbackCache(const QString &relay, const QString &bufferName, qint64 sizeLimit, QObject *parent)
+    : QObject(parent)
+    , m_file(directory() + "/" + QCryptographicHash::hash((relay + "\n" + bufferName).toUtf8(), QCryptographicHash::Sha1).toHex() + ".log")
+    , m_sizeLimit(sizeLimit)
+{
+    s_instances.append(this);
+}
+
+ScrollbackCache::~ScrollbackCache() {
+    s_instances.removeAll(this);
+}
+
+QString ScrollbackCache::directory() {
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/scrollback";
+}
+
+void ScrollbackCache::setTotalLimit(qint64 limit) {
+    s_totalLimit = limit;
+}
+
+QList<ScrollbackCache::Record> ScrollbackCache::load() {
+    qint64 validSize = 0;
+    auto records = readAll(&validSize);
+    // a record cut short (crash during a write) is dropped, appending continues after the last complete one
+    if (m_file.exists() && m_file.size() != validSize)
+        m_file.resize(validSize);
+
+    std::stable_sort(records.begin(), records.end(), [](const Record &a, const Record &b) {
+        return a.date > b.date;
+    });
+    m_keys.clear();
+    // lines appended before the file was read may be there twice
+    QList<Record> result;
+    result.reserve(records.count());
+    for (auto &i : records) {
+        auto k = key(i);
+        if (m_keys.contains(k))
+            continue;
+        m_keys.insert(k);
+        result.append(i);
+    }
+    m_loaded = true;
+    return result;
+}
+
+void ScrollbackCache::append(const Record &record) {
+    auto k = key(record);
+    if (m_keys.contains(k))
+        return;
+
+    if (!m_file.isOpen()) {
+        QDir().mkpath(directory());
+        if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            qWarning() << "Could not open scrollback cache" << m_file.fileName() << m_file.errorString();
+            return;
+        }
+    }
+    const auto sizeBefore = m_file.size();
+    if (sizeBefore == 0) {
+        QDataStream s(&m_file);
+        s.setVersion(c_streamVersion);
+        s << c_magic << c_version;
+    }
+    m_file.write(serialize(record));
+    m_file.flush();
+
+    m_keys.insert(k);
+
+    if (m_file.size() > m_sizeLimit)
+        compact(m_sizeLimit / 2);
+    else if (s_totalSize >= 0)
+        s_totalSize += m_file.size() - sizeBefore;
+    if (s_totalSize < 0 || s_totalSize > s_totalLimit)
+        enforceTotalLimit();
+}
+
+bool ScrollbackCache::contains(const QDateTime &date, const FormattedString &prefix, const FormattedString &message) const {
+    return m_keys.contains(key(date, prefix, message));
+}
+
+bool ScrollbackCache::isEmpty() const {
+    return !m_loaded || m_keys.isEmpty();
+}
+
+QList<ScrollbackCache::Record> ScrollbackCache::readAll(qint64 *validSize) {
+    QList<Record> result;
+    if (validSize)
+        *validSize = 0;
+
+    QFile file(m_file.fileName());
+    if (!file.exists() || !file.open(QIODevice::ReadOnly))
+        return result;
+    const auto size = file.size();
+    uchar *data = size > 0 ? file.map(0, size) : nullptr;
+    if (!data)
+        return result;
+
+    // the map is read in place, nothing gets copied until the strings are decoded
+    auto bytes = QByteArray::fromRawData(reinterpret_cast<const char*>(data), size);
+    QDataStream s(bytes);
+    s.setVersion(c_streamVersion);
+    quint32 magic = 0, version = 0;
+    s >> magic >> version;
+    if (magic == c_magic && version == c_version) {
+        qint64 valid = s.device()->pos();
+        while (!s.atEnd()) {
+            quint32 length = 0;
+            s >> length;
+            const auto payloadStart = s.device()->pos();
+            if (s.status() != QDataStream::Ok || length > size - payloadStart)
+                break;
+
+            Record r;
+            if (!readPayload(s, r))
+                break;
+            result.append(r);
+
+            s.device()->seek(payloadStart + length);
+            valid = s.device()->pos();
+        }
+        if (validSize)
+            *validSize = valid;
+    }
+    file.unmap(data);
+    return result;
+}
+
+void ScrollbackCache::compact(qint64 targetSize) {
+    auto records = readAll();
+    std::stable_sort(records.begin(), records.end(), [](const Record &a, const Record &b) {
+        return a.date > b.date;
+    });
+
+    // the target is below the limit so this doesn't run again right away
+    QList<QByteArray> kept;
+    QSet<Key> keys;
+    qint64 total = 0;
+    for (auto &i : records) {
+        auto k = key(i);
+        if (keys.contains(k))
+            continue;
+        auto serialized = serialize(i);
+        if (total + serialized.size() > targetSize)
+            break;
+        keys.insert(k);
+        total += serialized.size();
+        kept.prepend(serialized);
+    }
+
+    m_file.close();
+    QSaveFile out(m_file.fileName());
+    if (!out.open(QIODevice::WriteOnly))
+        return;
+    {
+        QDataStream s(&out);
+        s.setVersion(c_streamVersion);
+        s << c_magic << c_version;
+    }
+    for (auto &i : kept)
+        out.write(i);
+    if (!out.commit()) {
+        qWarning() << "Could not compact scrollback cache" << m_file.fileName() << out.errorString();
+        return;
+    }
+    // the keys are only known for a file that was read already
+    if (m_loaded)
+        load();
+    // the sizes changed, they're counted again when needed
+    s_totalSize = -1;
+}
+
+void ScrollbackCache::enforceTotalLimit() {
+    if (s_totalLimit <= 0)
+        return;
+    QHash<QString, ScrollbackCache*> open;
+    for (auto i : s_instances)
+        open.insert(QFileInfo(i->m_file).absoluteFilePath(), i);
+
+    // least recently written first
+    auto files = QDir(directory()).entryInfoList({ "*.log" }, QDir::Files, QDir::Time | QDir::Reversed);
+    qint64 total = 0;
+    for (auto &i : files)
+        total += i.size();
+    // down to three quarters of the limit so this doesn't run with every line
+    const qint64 target = s_totalLimit / 4 * 3;
+    if (total > s_totalLimit) {
+        for (auto &i : files) {
+            if (total <= target)
+                break;
+            if (open.contains(i.absoluteFilePath()))
+                continue;
+            if (QFile::remove(i.absoluteFilePath()))
+                total -= i.size();
+        }
+        // only the logs of the buffers in this session are left, the largest ones get halved
+        std::sort(files.begin(), files.end(), [](const QFileInfo &a, const QFileInfo &b) {
+            return a.size() > b.size();
+        });
+        for (auto &i : files) {
+            if (total <= target)
+                break;
+            auto cache = open.value(i.absoluteFilePath());
+            if (!cache)
+                continue;
+            cache->compact(i.size() / 2);
+            total -= i.size() - QFileInfo(i.absoluteFilePath()).size();
+        }
+    }
+    s_totalSize = total;
+}
+
+ScrollbackCache::Key ScrollbackCache::key(const Record &record) {
+    return key(record.date, record.prefix, record.message);
+}
+
+ScrollbackCache::Key ScrollbackCache::key(const QDateTime &date, const FormattedString &prefix, const FormattedString &message) {
+    return qMakePair(date.toSecsSinceEpoch(), qHashMulti(0, prefix.toPlain(), message.toPlain()));
+}
+
+bool ScrollbackCache::readPayload(QDataStream &s, Record &record) {
+    qint64 date = 0;
+    quint64 ptr = 0;
+    quint8 flags = 0;
+    s >> date >> ptr >> flags >> record.tags >> record.prefix >> record.message;
+    if (s.status() != QDataStream::Ok)
+        return false;
+    record.date = QDateTime::fromSecsSinceEpoch(date);
+    record.ptr = ptr;
+    record.displayed = flags & (1 << 0);
+    record.highlight = flags & (1 << 1);
+    return true;
+}
+
+bool ScrollbackCache::deserialize(const QByteArray &bytes, Record &record) {
+    QDataStream s(bytes);
+    s.setVersion(c_streamVersion);
+    quint32 length = 0;
+    s >> length;
+    return s.status() == QDataStream::Ok && qsizetype(length) <= bytes.size() - qsizetype(sizeof(quint32)) && readPayload(s, record);
+}
+
+QByteArray ScrollbackCache::serialize(const Record &record) {
+    QByteArray payload;
+    {
+        QDataStream s(&payload, QIODevice::WriteOnly);
+        s.setVersion(c_streamVersion);
+        quint8 flags = (record.displayed ? 1 << 0 : 0) | (record.highlight ? 1 << 1 : 0);
+        s << qint64(record.date.toSecsSinceEpoch()) << quint64(record.ptr) << flags << record.tags << record.prefix << record.message;
+    }
+    QByteArray result;
+    {
+        QDataStream s(&result, QIODevice::WriteOnly);
+        s.setVersion(c_streamVersion);
+        s << quint32(payload.size());
+    }
+    result.append(payload);
+    return result;
+}
@@ -0,0 +1,97 @@
+// Lith
+// Copyright (C) 2021 Martin Bříza
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SCROLLBACKCACHE_H
+#define SCROLLBACKCACHE_H
+
+#include "common.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QSet>
+
+/*
+ * On-disk log of the lines of a single buffer, identified by the relay and the full name of the buffer.
+ *
+ * The file is a header followed by length-prefixed records, new lines are only ever appended.
+ * It's read back through a memory map, only once load() is called, lines appended before
+ * that are deduplicated when the file is read. Once it grows over the size limit, it's rewritten
+ * with just the newest lines (compaction). All the logs together are kept under a total limit too,
+ * the least recently written files of buffers that aren't open are removed first.
+ */
+class ScrollbackCache : public QObject {
+    Q_OBJECT
+public:
+    struct Record {
+        QDateTime date {};
+        pointer_t ptr { 0 };
+        bool displayed { false };
+        bool highlight { false };
+        QStringList tags {};
+        FormattedString prefix {};
+        FormattedString message {};
+    };
+
+    // buffer names repeat across relays, the relay is a part of the identity of the log
+    ScrollbackCache(const QString &relay, const QString &bufferName, qint64 sizeLimit, QObject *parent = nullptr);
+
+    ~ScrollbackCache();
+
+    // all the stored lines, newest first
+    QList<Record> load();
+    void append(const Record &record);
+
+    // true if the line is stored already, lines are compared by their content,
+    // pointers change when WeeChat restarts
+    bool contains(const QDateTime &date, const FormattedString &prefix, const FormattedString &message) const;
+    // also true until load() was called
+    bool isEmpty() const;
+
+    static QString directory();
+    // for all the logs together, in bytes
+    static void setTotalLimit(qint64 limit);
+
+    // a single record as it's stored in the file, also used to keep lines compact in memory
+    static QByteArray serialize(const Record &record);
+    static bool deserialize(const QByteArray &bytes, Record &record);
+
+private:
+    using Key = QPair<qint64, size_t>;
+
+    QList<Record> readAll(qint64 *validSize = nullptr);
+    // keeps the newest lines that fit into the target size
+    void compact(qint64 targetSize);
+    static Key key(const Record &record);
+    static Key key(const QDateTime &date, const FormattedString &prefix, const FormattedString &message);
+    // removes and compacts logs until they fit into the total limit again
+    static void enforceTotalLimit();
+
+    // the part of a record after its length
+    static bool readPayload(QDataStream &s, Record &record);
+
+    QFile m_file;
+    qint64 m_sizeLimit;
+    QSet<Key> m_keys {};
+    bool m_loaded { false };
+
+    inline static QList<ScrollbackCache*> s_instances {};
+    inline static qint64 s_totalLimit { 0 };
+    // size of all the logs, -1 until the directory was looked at
+    inline static qint64 s_totalSize { -1 };
+};
+
+#endif // SCROLLBACKCACHE_H
@@ -0,0 +1,211 @@
+// Lith
+// Copyright (C) 2021 Martin Bříza
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+#include "searchindex.h"
+
+#include "datamodel.h"
+
+#include <algorithm>
+
+SearchIndex::SearchIndex(QObject *parent)
+    : QObject(parent)
+{
+
+}
+
+void SearchIndex::add(BufferLine *line) {
+    if (m_documentIds.contains(line))
+        return;
+    const quint32 id = m_documents.count();
+    m_documents.append({ line, line->buffer(), line->dateGet().toSecsSinceEpoch() });
+    m_documentIds.insert(line, id);
+
+    for (auto &i : terms(line)) {
+        auto &postings = m_postings[i];
+        // the same word twice in a line is indexed once
+        if (postings.isEmpty() || postings.last() != id)
+            postings.append(id);
+    }
+}
+
+void SearchIndex::remove(BufferLine *line) {
+    auto it = m_documentIds.find(line);
+    if (it == m_documentIds.end())
+        return;
+    // postings stay until the next compaction, the document is just marked as dead
+    m_documents[it.value()].line = nullptr;
+    m_documentIds.erase(it);
+    m_removedCount++;
+    if (m_removedCount > 1024 && m_removedCount > m_documents.count() / 2)
+        compact();
+}
+
+QList<SearchIndex::Hit> SearchIndex::query(const QString &query, int limit, const Buffer *buffer) const {
+    QList<Hit> result;
+    const auto words = parseQuery(query);
+    if (words.isEmpty())
+        return result;
+
+    QHash<quint32, int> scores;
+    bool first = true;
+    for (auto &word : words) {
+        // best score of this word for each document, exact matches count double
+        QHash<quint32, int> wordScores;
+        auto end = word.size() > 1 ? m_postings.end() : m_postings.upperBound(word);
+        for (auto it = m_postings.lowerBound(word); it != end && it.key().startsWith(word); ++it) {
+            const int weight = it.key() == word ? 2 : 1;
+            for (auto id : it.value()) {
+                if (first || scores.contains(id)) {
+                    auto &score = wordScores[id];
+                    score = qMax(score, weight);
+                }
+            }
+        }
+        // all words have to match
+        QHash<quint32, int> combined;
+        for (auto it = wordScores.cbegin(); it != wordScores.cend(); ++it)
+            combined.insert(it.key(), scores.value(it.key()) + it.value());
+        scores.swap(combined);
+        first = false;
+        if (scores.isEmpty())
+            return result;
+    }
+
+    QVector<quint32> ids;
+    ids.reserve(scores.count());
+    for (auto it = scores.cbegin(); it != scores.cend(); ++it) {
+        auto &document = m_documents[it.key()];
+        if (document.line && (!buffer || document.buffer == buffer))
+            ids.append(it.key());
+    }
+    auto byRank = [this, &scores](quint32 a, quint32 b) {
+        auto scoreA = scores.value(a), scoreB = scores.value(b);
+        if (scoreA != scoreB)
+            return scoreA > scoreB;
+        return m_documents[a].date > m_documents[b].date;
+    };
+    if (limit > 0 && ids.count() > limit) {
+        std::partial_sort(ids.begin(), ids.begin() + limit, ids.end(), byRank);
+        ids.resize(limit);
+    }
+    else {
+        std::sort(ids.begin(), ids.end(), byRank);
+    }
+    for (auto id : ids)
+        result.append({ m_documents[id].line, scores.value(id) });
+    return result;
+}
+
+QStringList SearchIndex::parseQuery(const QString &query) {
+    QStringList result;
+    for (auto &i : query.split(' ', Qt::SkipEmptyParts)) {
+        auto folded = i.toCaseFolded();
+        // tokenize would split the nick: and tag: filters on the colon
+        if (folded.startsWith("nick:") || folded.startsWith("tag:"))
+            result.append(folded);
+        else
+            result.append(tokenize(folded));
+    }
+    return result;
+}
+
+bool SearchIndex::matches(const QStringList &words, const BufferLine *line) {
+    return score(words, terms(line)) > 0;
+}
+
+int SearchIndex::score(const QStringList &words, const QStringList &terms) {
+    int result = 0;
+    for (auto &word : words) {
+        // exact matches count double, like in query()
+        int best = 0;
+        for (auto &term : terms) {
+            if (term == word)
+                best = 2;
+            else if (word.size() > 1 && term.startsWith(word))
+                best = qMax(best, 1);
+        }
+        if (best == 0)
+            return 0;
+        result += best;
+    }
+    return result;
+}
+
+QStringList SearchIndex::terms(const FormattedString &message, const QString &nick, const QStringList &tags) {
+    QStringList result = tokenize(message.toPlain());
+    auto folded = nick.toCaseFolded();
+    if (!folded.isEmpty()) {
+        result.append(folded);
+        result.append("nick:" + folded);
+    }
+    for (auto &i : tags)
+        result.append("tag:" + i.toCaseFolded());
+    return result;
+}
+
+QStringList SearchIndex::terms(const BufferLine *line) {
+    return terms(line->messageGet(), line->nickGet(), line->tags_arrayGet());
+}
+
+int SearchIndex::count() const {
+    return m_documentIds.count();
+}
+
+QStringList SearchIndex::tokenize(const QString &text) {
+    QStringList result;
+    int start = -1;
+    for (int i = 0; i <= text.size(); i++) {
+        bool wordChar = i < text.size() && (text[i].isLetterOrNumber() || text[i] == '_');
+        if (wordChar && start < 0) {
+            start = i;
+        }
+        else if (!wordChar && start >= 0) {
+            result.append(text.mid(start, i - start).toCaseFolded());
+            start = -1;
+        }
+    }
+    return result;
+}
+
+void SearchIndex::compact() {
+    // renumber the live documents and drop the dead ones from all postings
+    QVector<quint32> remap(m_documents.count(), quint32(-1));
+    QVector<Document> documents;
+    documents.reserve(m_documentIds.count());
+    for (int i = 0; i < m_documents.count(); i++) {
+        if (!m_documents[i].line)
+            continue;
+        remap[i] = documents.count();
+        m_documentIds[m_documents[i].line] = documents.count();
+        documents.append(m_documents[i]);
+    }
+    for (auto it = m_postings.begin(); it != m_postings.end(); ) {
+        QVector<quint32> postings;
+        for (auto id : it.value()) {
+            if (remap[id] != quint32(-1))
+                postings.append(remap[id]);
+        }
+        if (postings.isEmpty()) {
+            it = m_postings.erase(it);
+        }
+        else {
+            it.value().swap(postings);
+            ++it;
+        }
+    }
+    m_documents.swap(documents);
+    m_removedCount = 0;
+}
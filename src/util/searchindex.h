@@ -0,0 +1,83 @@
+// Lith
+// Copyright (C) 2021 Martin Bříza
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include "common.h"
+
+#include <QHash>
+#include <QMap>
+#include <QVector>
+
+class Buffer;
+class BufferLine;
+
+/*
+ * Inverted index over the plain text, nick and tags of every line that's been received.
+ *
+ * Terms are case folded words of the message, the nick is stored both as a word and as "nick:<nick>",
+ * tags as "tag:<tag>". Query words match terms by prefix and all of them have to match, hits are
+ * ranked by the number of exact matches and then by date. Single character words only match
+ * whole terms, as a prefix they'd go through a large part of the index.
+ */
+class SearchIndex : public QObject {
+    Q_OBJECT
+public:
+    struct Hit {
+        BufferLine *line;
+        int score;
+    };
+
+    SearchIndex(QObject *parent = nullptr);
+
+    void add(BufferLine *line);
+    void remove(BufferLine *line);
+
+    // buffer limits the results to a single buffer
+    QList<Hit> query(const QString &query, int limit, const Buffer *buffer = nullptr) const;
+    // the words of a query as they're matched against the terms
+    static QStringList parseQuery(const QString &query);
+    // the same test query() does, for a single line that doesn't have to be in the index
+    static bool matches(const QStringList &words, const BufferLine *line);
+    // the score query() would give a line with these terms, 0 if it doesn't match
+    static int score(const QStringList &words, const QStringList &terms);
+    // what a line gets indexed under
+    static QStringList terms(const FormattedString &message, const QString &nick, const QStringList &tags);
+
+    int count() const;
+
+    static QStringList tokenize(const QString &text);
+
+private:
+    static QStringList terms(const BufferLine *line);
+
+    struct Document {
+        BufferLine *line { nullptr };
+        const Buffer *buffer { nullptr };
+        qint64 date { 0 };
+    };
+
+    void compact();
+
+    QVector<Document> m_documents {};
+    QHash<BufferLine*, quint32> m_documentIds {};
+    // ordered so prefixes can be looked up as ranges, postings are sorted because ids only grow
+    QMap<QString, QVector<quint32>> m_postings {};
+    int m_removedCount { 0 };
+};
+
+#endif // SEARCHINDEX_H
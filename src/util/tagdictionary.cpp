@@ -0,0 +1,110 @@
+// Lith
+// Copyright (C) 2021 Martin Bříza
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+#include "tagdictionary.h"
+
+TagDictionary &TagDictionary::instance() {
+    static TagDictionary dictionary;
+    return dictionary;
+}
+
+TagDictionary::TagDictionary() {
+    // has to follow the order of TagDictionary::Tag
+    for (auto i : { "irc_privmsg", "irc_notice", "irc_action", "irc_join", "irc_part", "irc_quit", "irc_nick", "irc_mode", "irc_topic",
+                    "self_msg", "no_highlight", "notify_none", "notify_message", "notify_private", "notify_highlight" }) {
+        intern(i);
+    }
+    Q_ASSERT(m_names.count() == WellKnownTagCount);
+}
+
+int TagDictionary::intern(const QString &tag) {
+    auto it = m_ids.constFind(tag);
+    if (it != m_ids.constEnd())
+        return it.value();
+
+    if (isRare(tag) || m_names.count() >= c_bitsetSize)
+        return -1;
+    int id = m_names.count();
+    m_names.append(tag);
+    m_ids.insert(tag, id);
+    return id;
+}
+
+const QString &TagDictionary::name(int id) const {
+    return m_names[id];
+}
+
+int TagDictionary::count() const {
+    return m_names.count();
+}
+
+bool TagDictionary::isRare(const QString &tag) {
+    return tag.startsWith(QLatin1String("nick_")) || tag.startsWith(QLatin1String("host_")) || tag.startsWith(QLatin1String("prefix_nick_"));
+}
+
+TagSet::TagSet(const QStringList &tags) {
+    auto &dictionary = TagDictionary::instance();
+    for (auto &i : tags) {
+        auto id = dictionary.intern(i);
+        if (id >= 0) {
+            if (m_bits & (quint64(1) << id))
+                continue;
+            m_bits |= quint64(1) << id;
+            m_order.append(char(id));
+        }
+        else if (!m_rare.contains(i)) {
+            m_rare.append(i);
+            m_order.append(char(c_rareTag));
+        }
+    }
+}
+
+bool TagSet::contains(TagDictionary::Tag tag) const {
+    return m_bits & (quint64(1) << tag);
+}
+
+bool TagSet::containsAny(std::initializer_list<TagDictionary::Tag> tags) const {
+    quint64 mask = 0;
+    for (auto i : tags)
+        mask |= quint64(1) << i;
+    return m_bits & mask;
+}
+
+bool TagSet::isEmpty() const {
+    return m_bits == 0 && m_rare.isEmpty();
+}
+
+QStringList TagSet::toStringList() const {
+    auto &dictionary = TagDictionary::instance();
+    QStringList result;
+    result.reserve(m_order.size());
+    int rare = 0;
+    for (auto i : m_order) {
+        if (quint8(i) == c_rareTag)
+            result.append(m_rare[rare++]);
+        else
+            result.append(dictionary.name(quint8(i)));
+    }
+    return result;
+}
+
+bool TagSet::operator==(const TagSet &o) const {
+    return m_order == o.m_order && m_bits == o.m_bits && m_rare == o.m_rare;
+}
+
+bool TagSet::operator!=(const TagSet &o) const {
+    return !operator==(o);
+}
@@ -0,0 +1,105 @@
+// Lith
+// Copyright (C) 2021 Martin Bříza
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TAGDICTIONARY_H
+#define TAGDICTIONARY_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QStringList>
+
+#include <initializer_list>
+
+/*
+ * The tags lines commonly share (message types, notify levels, ...) are stored only once
+ * and lines refer to them by their id, TagSet keeps those as bits.
+ *
+ * There are only 64 of these ids. Tags unique to a nick or a host (nick_xxx, host_xxx) and anything
+ * that doesn't fit anymore aren't registered at all, TagSet keeps them as strings so they go away
+ * together with the lines. Only to be used from the GUI thread.
+ */
+class TagDictionary {
+public:
+    // ids of the tags the client looks at, they're registered up front so they always fit the bitset
+    enum Tag : quint32 {
+        IrcPrivmsg,
+        IrcNotice,
+        IrcAction,
+        IrcJoin,
+        IrcPart,
+        IrcQuit,
+        IrcNick,
+        IrcMode,
+        IrcTopic,
+        SelfMsg,
+        NoHighlight,
+        NotifyNone,
+        NotifyMessage,
+        NotifyPrivate,
+        NotifyHighlight,
+        WellKnownTagCount
+    };
+    static const int c_bitsetSize = 64;
+
+    static TagDictionary &instance();
+
+    // id of the tag, -1 if it doesn't get one
+    int intern(const QString &tag);
+    const QString &name(int id) const;
+    int count() const;
+
+    // true for tags that shouldn't take one of the bitset slots
+    static bool isRare(const QString &tag);
+
+private:
+    TagDictionary();
+    Q_DISABLE_COPY(TagDictionary)
+
+    QHash<QString, int> m_ids {};
+    // names of the tags, indexed by their id
+    QStringList m_names {};
+};
+
+/*
+ * Tags of a single line, in the order they came in.
+ */
+class TagSet {
+public:
+    TagSet() = default;
+    explicit TagSet(const QStringList &tags);
+
+    bool contains(TagDictionary::Tag tag) const;
+    // true if any of the well known tags is present
+    bool containsAny(std::initializer_list<TagDictionary::Tag> tags) const;
+    bool isEmpty() const;
+
+    QStringList toStringList() const;
+
+    bool operator==(const TagSet &o) const;
+    bool operator!=(const TagSet &o) const;
+
+private:
+    // stands for the next tag of m_rare in m_order
+    static const quint8 c_rareTag = 0xFF;
+
+    quint64 m_bits { 0 };
+    // ids of the tags as they came in
+    QByteArray m_order {};
+    // tags without an id
+    QStringList m_rare {};
+};
+
+#endif // TAGDICTIONARY_H
@@ -0,0 +1,191 @@
+// Lith
+// Copyright (C) 2021 Martin Bříza
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+#include "timestampformatter.h"
+
+#include <QLocale>
+
+// the UTC offset is assumed to stay the same within a bucket, DST changes happen on quarters of an hour
+static const qint64 c_offsetBucketSeconds = 15 * 60;
+
+TimestampFormatter::TimestampFormatter(const QString &format) {
+    setFormat(format);
+}
+
+void TimestampFormatter::setFormat(const QString &format) {
+    m_format = format;
+    m_compiled = compile(format);
+    m_am = QLocale().amText();
+    m_pm = QLocale().pmText();
+    m_cache.clear();
+}
+
+QString TimestampFormatter::format(const QDateTime &date) {
+    if (!date.isValid())
+        return QString();
+    return format(date.toSecsSinceEpoch());
+}
+
+QString TimestampFormatter::format(qint64 secsSinceEpoch) {
+    if (auto cached = m_cache.object(secsSinceEpoch))
+        return *cached;
+
+    QString result;
+    if (m_compiled) {
+        const qint64 local = secsSinceEpoch + utcOffset(secsSinceEpoch);
+        const int dayTime = int(((local % 86400) + 86400) % 86400);
+        const int hour = dayTime / 3600;
+        const int minute = dayTime / 60 % 60;
+        const int second = dayTime % 60;
+        const int hour12 = hour % 12 == 0 ? 12 : hour % 12;
+        auto twoDigits = [](int n) {
+            return QString::number(n).rightJustified(2, '0');
+        };
+        for (auto &i : m_tokens) {
+            switch (i.field) {
+            case Literal:
+                result.append(i.literal);
+                break;
+            case Hour12:
+                result.append(QString::number(hour12));
+                break;
+            case Hour12Padded:
+                result.append(twoDigits(hour12));
+                break;
+            case Hour24:
+                result.append(QString::number(hour));
+                break;
+            case Hour24Padded:
+                result.append(twoDigits(hour));
+                break;
+            case Minute:
+                result.append(QString::number(minute));
+                break;
+            case MinutePadded:
+                result.append(twoDigits(minute));
+                break;
+            case Second:
+                result.append(QString::number(second));
+                break;
+            case SecondPadded:
+                result.append(twoDigits(second));
+                break;
+            case AmPmUpper:
+                result.append((hour < 12 ? m_am : m_pm).toUpper());
+                break;
+            case AmPmLower:
+                result.append((hour < 12 ? m_am : m_pm).toLower());
+                break;
+            }
+        }
+    }
+    else {
+        result = QLocale().toString(QDateTime::fromSecsSinceEpoch(secsSinceEpoch).time(), m_format);
+    }
+    m_cache.insert(secsSinceEpoch, new QString(result));
+    return result;
+}
+
+bool TimestampFormatter::compile(const QString &format) {
+    // follows the QTime::toString rules for the fields it knows
+    m_tokens.clear();
+    bool hasAmPm = false;
+    QString literal;
+    auto flushLiteral = [this, &literal]() {
+        if (!literal.isEmpty())
+            m_tokens.append({ Literal, literal });
+        literal.clear();
+    };
+    for (int i = 0; i < format.size(); ) {
+        const QChar c = format[i];
+        int repeat = 1;
+        while (i + repeat < format.size() && format[i + repeat] == c)
+            repeat++;
+
+        if (c == '\'') {
+            // quoted text, '' is a quote both inside and outside of it
+            if (i + 1 < format.size() && format[i + 1] == '\'') {
+                literal.append('\'');
+                i += 2;
+                continue;
+            }
+            i++;
+            while (i < format.size()) {
+                if (format[i] != '\'') {
+                    literal.append(format[i++]);
+                }
+                else if (i + 1 < format.size() && format[i + 1] == '\'') {
+                    literal.append('\'');
+                    i += 2;
+                }
+                else {
+                    i++;
+                    break;
+                }
+            }
+            continue;
+        }
+
+        Field field = Literal;
+        int length = qMin(repeat, 2);
+        if (c == 'h')
+            field = length == 2 ? Hour12Padded : Hour12;
+        else if (c == 'H')
+            field = length == 2 ? Hour24Padded : Hour24;
+        else if (c == 'm')
+            field = length == 2 ? MinutePadded : Minute;
+        else if (c == 's')
+            field = length == 2 ? SecondPadded : Second;
+        else if (c == 'A' || c == 'a') {
+            length = (i + 1 < format.size() && format[i + 1].toLower() == 'p') ? 2 : 1;
+            field = c == 'A' ? AmPmUpper : AmPmLower;
+            hasAmPm = true;
+        }
+        else if (c.isLetter() && c.unicode() < 128) {
+            // milliseconds, time zones and whatever else QTime understands
+            return false;
+        }
+        else {
+            literal.append(c);
+            i++;
+            continue;
+        }
+        flushLiteral();
+        m_tokens.append({ field });
+        i += length;
+    }
+    flushLiteral();
+
+    // without AM/PM the hours are always 24 hour based, even with h
+    if (!hasAmPm) {
+        for (auto &i : m_tokens) {
+            if (i.field == Hour12)
+                i.field = Hour24;
+            else if (i.field == Hour12Padded)
+                i.field = Hour24Padded;
+        }
+    }
+    return true;
+}
+
+int TimestampFormatter::utcOffset(qint64 secsSinceEpoch) {
+    const qint64 bucket = secsSinceEpoch / c_offsetBucketSeconds;
+    if (bucket != m_offsetBucket) {
+        m_offsetBucket = bucket;
+        m_offset = QDateTime::fromSecsSinceEpoch(bucket * c_offsetBucketSeconds).offsetFromUtc();
+    }
+    return m_offset;
+}
@@ -0,0 +1,74 @@
+// Lith
+// Copyright (C) 2021 Martin Bříza
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TIMESTAMPFORMATTER_H
+#define TIMESTAMPFORMATTER_H
+
+#include <QCache>
+#include <QDateTime>
+#include <QList>
+#include <QString>
+
+/*
+ * Formats line timestamps with the QTime format from the settings (timestampFormat).
+ *
+ * The format is parsed once, the time of day is then computed from the epoch seconds directly,
+ * with the local UTC offset looked up once per quarter of an hour. Formats using anything besides
+ * hours, minutes, seconds and AM/PM are left to QLocale. Either way the strings are cached per second.
+ * Only to be used from the GUI thread.
+ */
+class TimestampFormatter {
+public:
+    TimestampFormatter(const QString &format = QString());
+
+    void setFormat(const QString &format);
+    QString format(const QDateTime &date);
+    QString format(qint64 secsSinceEpoch);
+
+private:
+    enum Field : quint8 {
+        Literal,
+        Hour12,
+        Hour12Padded,
+        Hour24,
+        Hour24Padded,
+        Minute,
+        MinutePadded,
+        Second,
+        SecondPadded,
+        AmPmUpper,
+        AmPmLower,
+    };
+    struct Token {
+        Field field;
+        QString literal {};
+    };
+
+    bool compile(const QString &format);
+    int utcOffset(qint64 secsSinceEpoch);
+
+    QString m_format {};
+    QList<Token> m_tokens {};
+    // false if the format has something the tokens can't express
+    bool m_compiled { false };
+    QString m_am {};
+    QString m_pm {};
+    QCache<qint64, QString> m_cache { 4096 };
+    qint64 m_offsetBucket { -1 };
+    int m_offset { 0 };
+};
+
+#endif // TIMESTAMPFORMATTER_H
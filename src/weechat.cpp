@@ -247,12 +247,26 @@ bool Weechat::input(pointer_t ptr, const QString &data) {
 }
 
 void Weechat::fetchLines(pointer_t ptr, int count) {
-    auto line = QString("(handleFetchLines;%1) hdata buffer:0x%2/lines/last_line(-%3)/data\n").arg(m_messageOrder++).arg(ptr, 0, 16).arg(count);
+    auto line = QString("(handleFetchLines;%1;%2) hdata buffer:0x%2/lines/last_line(-%3)/data\n").arg(m_messageOrder++).arg(ptr, 0, 16).arg(count);
     //qCritical() << "WRITING:" << line;
     m_connection->write(line.toUtf8());
     m_timeoutTimer->start(5000);
 }
 
+void Weechat::fetchLinesBefore(pointer_t bufferPtr, pointer_t linePtr, int count) {
+    // walks back from linePtr (included in the reply) through prev_line
+    auto line = QString("(handleFetchLines;%1;%2) hdata line:0x%3(-%4)/data\n").arg(m_messageOrder++).arg(bufferPtr, 0, 16).arg(linePtr, 0, 16).arg(count);
+    m_connection->write(line.toUtf8());
+    m_timeoutTimer->start(5000);
+}
+
+void Weechat::fetchOldestLines(pointer_t ptr, int count) {
+    // the relay checks the buffer pointer, it's the same list the line pointers used for paging come from
+    auto line = QString("(handleOldestLines;%1;%2) hdata buffer:0x%2/lines/first_line(%3)/data\n").arg(m_messageOrder++).arg(ptr, 0, 16).arg(count);
+    m_connection->write(line.toUtf8());
+    m_timeoutTimer->start(5000);
+}
+
 void Weechat::onMessageReceived(QByteArray &data) {
     //qCritical() << "Message!" << data;
     QDataStream s(&data, QIODevice::ReadOnly);
@@ -273,8 +287,18 @@ void Weechat::onMessageReceived(QByteArray &data) {
             }
         }
         else {
-            auto name = id.split(";").first();
-            if (!QMetaObject::invokeMethod(Lith::instance(), name.toStdString().c_str(), Qt::QueuedConnection, Q_ARG(Protocol::HData, hda))) {
+            auto idParts = id.split(";");
+            auto name = idParts.first();
+            bool invoked = false;
+            // third part of the id is the pointer the request was made for, passed along to the handler
+            if (idParts.count() > 2) {
+                pointer_t context = idParts[2].toULongLong(nullptr, 16);
+                invoked = QMetaObject::invokeMethod(Lith::instance(), name.toStdString().c_str(), Qt::QueuedConnection, Q_ARG(Protocol::HData, hda), Q_ARG(pointer_t, context));
+            }
+            else {
+                invoked = QMetaObject::invokeMethod(Lith::instance(), name.toStdString().c_str(), Qt::QueuedConnection, Q_ARG(Protocol::HData, hda));
+            }
+            if (!invoked) {
                 qWarning() << "Possible unhandled message:" << name;
             }
         }
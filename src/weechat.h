@@ -45,6 +45,8 @@ public slots:
 
     bool input(pointer_t ptr, const QString &data);
     void fetchLines(pointer_t ptr, int count);
+    void fetchLinesBefore(pointer_t bufferPtr, pointer_t linePtr, int count);
+    void fetchOldestLines(pointer_t ptr, int count);
 
 private slots:
 
@@ -80,7 +80,12 @@ Drawer {
                 Layout.fillWidth: true
                 placeholderText: qsTr("Filter buffers")
                 text: lith.buffers.filterWord
-                onTextChanged: lith.buffers.filterWord = text
+                onTextChanged: {
+                    lith.buffers.filterWord = text
+                    // the best match is on top
+                    if (text.length > 0)
+                        bufferList.currentIndex = 0
+                }
                 font.pointSize: settings.baseFontSize * 1.125
 
                 Keys.onPressed: {
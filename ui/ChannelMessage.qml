@@ -16,7 +16,6 @@
 // along with this program; If not, see <http://www.gnu.org/licenses/>.
 
 import QtQuick 2.12
-import QtQuick.Layouts 1.3
 import QtQuick.Controls 2.4
 
 import lith 1.0
@@ -26,7 +25,11 @@ Rectangle {
     z: index
     width: ListView.view.width // + timeMetrics.width
     property var messageModel: null
-    height: messageRootLayout.height
+    // set for a row standing for a run of join/part/quit messages
+    property string summary: ""
+    property bool expanded: false
+    signal toggled()
+    height: summary.length > 0 ? summaryText.height : messageText.height
 
     color: messageModel.highlight ? "#22880000" : "transparent"
     Connections {
@@ -53,40 +56,35 @@ Rectangle {
                                           messageModel.date)
         }
     }
-    RowLayout {
-        id: messageRootLayout
+    MessageItem {
+        id: messageText
+        visible: root.summary.length === 0
         width: parent.width
-        spacing: 0
-        Text {
-            Layout.alignment: Qt.AlignTop
-            text: messageModel.date.toLocaleTimeString(Qt.locale(), lith.settings.timestampFormat) + "\u00A0"
-            font.pointSize: settings.baseFontSize
-            color: disabledPalette.text
-            textFormat: Text.RichText
-            renderType: Text.NativeRendering
+        height: implicitHeight
+        // renderGeneration changes with the timestamp format
+        timestamp: lith.renderGeneration, messageModel.timestamp
+        prefix: messageModel.prefix
+        prefixLength: lith.settings.nickCutoffThreshold
+        message: messageModel.message
+        font.pointSize: settings.baseFontSize
+        color: palette.text
+        timestampColor: disabledPalette.text
+        linkColor: palette.link
+        onLinkActivated: {
+            linkHandler.show(link, root)
         }
-        Text {
-            Layout.alignment: Qt.AlignTop
-            font.bold: true
-            text: messageModel.prefix.toTrimmedHtml(lith.settings.nickCutoffThreshold)
-            font.pointSize: settings.baseFontSize
-            color: palette.text
-            textFormat: Text.RichText
-            renderType: Text.NativeRendering
-        }
-
-        Text {
-            id: messageText
-            text: messageModel.message
-            Layout.fillWidth: true
-            wrapMode: Text.WrapAtWordBoundaryOrAnywhere
-            color: palette.text
-            font.pointSize: settings.baseFontSize
-            textFormat: Text.RichText
-            renderType: Text.NativeRendering
-            onLinkActivated: {
-                linkHandler.show(link, root)
-            }
+    }
+    Label {
+        id: summaryText
+        visible: root.summary.length > 0
+        width: parent.width
+        text: (root.expanded ? "\u25BE " : "\u25B8 ") + root.summary
+        font.pointSize: settings.baseFontSize
+        color: disabledPalette.text
+        MouseArea {
+            anchors.fill: parent
+            cursorShape: Qt.PointingHandCursor
+            onClicked: root.toggled()
         }
     }
 }
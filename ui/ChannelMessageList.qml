@@ -18,9 +18,14 @@ import QtQuick 2.12
 import QtQuick.Controls 2.12
 import QtQuick.Layouts 1.12
 
+import lith 1.0
+
 ListView {
     id: listView
 
+    // the buffer shown in the list, there's a list for each of the recently shown buffers
+    property Buffer buffer: null
+
     // ugh, this is an ugly hack to fix the button under the Drawer drag area
     // Qt doesn't seem to care about this https://bugreports.qt.io/browse/QTBUG-59141
     // note the whole widget is rotated by 180 degress so it has to be subtracted from the height
@@ -48,9 +53,12 @@ ListView {
     verticalLayoutDirection: ListView.BottomToTop
     orientation: Qt.Vertical
     spacing: lith.settings.messageSpacing
-    model: lith.selectedBuffer ? lith.selectedBuffer.lines_filtered : null
+    model: buffer ? buffer.lines_collapsed : null
     delegate: ChannelMessage {
         messageModel: modelData
+        summary: model.summary
+        expanded: model.expanded
+        onToggled: listView.model.toggleExpanded(index)
     }
 
     ChannelMessageActionMenu {
@@ -58,17 +66,26 @@ ListView {
     }
 
     function fillTopOfList() {
-        if (!lith.selectedBuffer)
+        // hidden lists don't fetch anything until they're shown again
+        if (!buffer || !visible)
             return
         if (yPosition - visibleArea.heightRatio < 0.25) {
-            lith.selectedBuffer.fetchMoreLines()
+            buffer.fetchMoreLines()
         }
     }
 
+    // a batch of lines changes the content height many times in a row, check just once after it
+    Timer {
+        id: fillTopOfListTimer
+        interval: 0
+        onTriggered: fillTopOfList()
+    }
+
     property real yPosition: visibleArea.yPosition
     onYPositionChanged: fillTopOfList()
-    onContentHeightChanged: fillTopOfList()
+    onContentHeightChanged: fillTopOfListTimer.restart()
     onModelChanged: fillTopOfList()
+    onVisibleChanged: fillTopOfList()
 
     property real absoluteYPosition: yPosition + visibleArea.heightRatio
     onAbsoluteYPositionChanged: {
@@ -123,34 +123,33 @@ TextField {
             i = 0
             lastWord = inputField.text.substring(i, cursorPosition).trim().toLocaleLowerCase()
         }
-        var nicks = lith.selectedBuffer.getVisibleNicks()
+        // only the nicks starting with lastWord, the ones who spoke last come first
+        var nicks = lastWord !== "" ? lith.selectedBuffer.complete(lastWord, 64) : []
 
         for (var y = 0; y < nicks.length; y++) {
-            if (nicks[y].toLocaleLowerCase().startsWith(lastWord) && lastWord !== "") {
-                if(matchedNicks.length < 1) // We only want to add the first nick to the message for now
-                {
-                    var tmp_orig = inputField.text.substring(0, i)
-                    var tmp_to_add = ""; // Since we sometimes have ": " and " ", let's store it seperately for the cursorPosition hack
-
-                    if (i !== 0) {
-                        tmp_to_add += " "
-                        tmp_to_add += nicks[y] + " "
-                        cursorWasAtStart = false
-                    }
-                    else {
-                        tmp_to_add += nicks[y] + ": "
-                        cursorWasAtStart = true // this is just easier than grabbing ": " again
-                    }
-
-                    // Add the text before the tabbed "lastWord", then add the nickname and finally add the text that was there after the tabbed "lastWord"
-                    inputField.text = tmp_orig + tmp_to_add + inputField.text.substring(i + lastWord.length + (cursorWasAtStart ? 0 : 1), inputField.text.length)
+            if(matchedNicks.length < 1) // We only want to add the first nick to the message for now
+            {
+                var tmp_orig = inputField.text.substring(0, i)
+                var tmp_to_add = ""; // Since we sometimes have ": " and " ", let's store it seperately for the cursorPosition hack
 
-                    // Hack back the cursorPosition since we used inputField.text = which messed it up to the end
-                    cursorPosition = i + tmp_to_add.length
+                if (i !== 0) {
+                    tmp_to_add += " "
+                    tmp_to_add += nicks[y] + " "
+                    cursorWasAtStart = false
                 }
+                else {
+                    tmp_to_add += nicks[y] + ": "
+                    cursorWasAtStart = true // this is just easier than grabbing ": " again
+                }
+
+                // Add the text before the tabbed "lastWord", then add the nickname and finally add the text that was there after the tabbed "lastWord"
+                inputField.text = tmp_orig + tmp_to_add + inputField.text.substring(i + lastWord.length + (cursorWasAtStart ? 0 : 1), inputField.text.length)
 
-                matchedNicks.push(nicks[y]) // But add all of them to the list to be used when Tab is used again
+                // Hack back the cursorPosition since we used inputField.text = which messed it up to the end
+                cursorPosition = i + tmp_to_add.length
             }
+
+            matchedNicks.push(nicks[y]) // But add all of them to the list to be used when Tab is used again
         }
 
         if (matchedNicks.length == 1) {
@@ -312,6 +311,8 @@ TextField {
             event.accepted = true
         }
 
+        if (!channelMessageList)
+            return
         if (event.key === Qt.Key_Up) {
             channelMessageList.contentY -= 30
         }
@@ -29,7 +29,10 @@ ColumnLayout {
     property bool inputBarHasFocus: inputBar.hasFocus
     property alias textInput: inputBar.textInput
     property alias messageArea: messageArea
-    property alias scrollToBottomButtonPosition: channelMessageList.scrollToBottomButtonPosition
+    property real scrollToBottomButtonPosition: channelMessageList ? channelMessageList.scrollToBottomButtonPosition : 0
+    // the list showing the selected buffer
+    property Item channelMessageList: null
+    property int buffersShown: 0
 
     ChannelHeader {
         id: channelHeader
@@ -75,11 +78,17 @@ ColumnLayout {
             }
         }
 
-        ChannelMessageList {
-            id: channelMessageList
-            width: parent.width
-            height: parent.height
-            visible: lith.selectedBuffer
+        // the lists of the last few buffers stay around, switching back to one of them doesn't create its delegates again
+        // Lith keeps the line models of more buffers than there are lists here, so they don't get released under them
+        Repeater {
+            id: channelMessageLists
+            model: 4
+            ChannelMessageList {
+                property int lastShown: 0
+                width: messageArea.width
+                height: messageArea.height
+                visible: buffer && buffer === lith.selectedBuffer
+            }
         }
 
         DropHandler {
@@ -90,6 +99,42 @@ ColumnLayout {
         }
     }
 
+    function showSelectedBuffer() {
+        var buffer = lith.selectedBuffer
+        if (!buffer)
+            return
+        var list = null
+        for (var i = 0; i < channelMessageLists.count; i++) {
+            var item = channelMessageLists.itemAt(i)
+            if (item && item.buffer === buffer) {
+                list = item
+                break
+            }
+        }
+        if (!list) {
+            // the least recently shown one gets reused
+            for (i = 0; i < channelMessageLists.count; i++) {
+                item = channelMessageLists.itemAt(i)
+                if (item && (!list || item.lastShown < list.lastShown))
+                    list = item
+            }
+            if (!list)
+                return
+            list.buffer = buffer
+        }
+        buffersShown++
+        list.lastShown = buffersShown
+        channelMessageList = list
+    }
+
+    Connections {
+        target: lith
+        function onSelectedBufferChanged() {
+            showSelectedBuffer()
+        }
+    }
+    Component.onCompleted: showSelectedBuffer()
+
     HotList {
         id: hotlist
         visible: lith.settings.hotlistEnabled
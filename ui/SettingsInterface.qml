@@ -45,6 +45,8 @@ ScrollView {
         settings.hotlistShowUnreadCount = hotlistShowUnreadCountCheckbox.checked
         settings.messageSpacing = messageSpacingSpinbox.value
         settings.showJoinPartQuitMessages = showJoinPartQuitMessagesCheckbox.checked
+        settings.collapseJoinPartQuitMessages = collapseJoinPartQuitMessagesCheckbox.checked
+        settings.scrollbackCache = scrollbackCacheCheckbox.checked
         settings.baseFontFamily = fontDialog.currentFont.family
     }
     function onRejected() {
@@ -68,6 +70,8 @@ ScrollView {
         hotlistShowUnreadCountCheckbox.checked = settings.hotlistShowUnreadCount
         messageSpacingSpinbox.value = settings.messageSpacing
         showJoinPartQuitMessagesCheckbox.checked = settings.showJoinPartQuitMessages
+        collapseJoinPartQuitMessagesCheckbox.checked = settings.collapseJoinPartQuitMessages
+        scrollbackCacheCheckbox.checked = settings.scrollbackCache
         fontChangeButton.text = settings.baseFontFamily
         fontChangeButton.font.family = settings.baseFontFamily
         fontDialog.currentFont.family = settings.baseFontFamily
@@ -142,6 +146,27 @@ ScrollView {
                 Layout.alignment: Qt.AlignRight
             }
 
+            Label {
+                Layout.alignment: Qt.AlignLeft
+                text: qsTr("Collapse join/part/quit messages")
+            }
+            CheckBox {
+                id: collapseJoinPartQuitMessagesCheckbox
+                checked: settings.collapseJoinPartQuitMessages
+                enabled: showJoinPartQuitMessagesCheckbox.checked
+                Layout.alignment: Qt.AlignRight
+            }
+
+            Label {
+                Layout.alignment: Qt.AlignLeft
+                text: qsTr("Store messages on this device")
+            }
+            CheckBox {
+                id: scrollbackCacheCheckbox
+                checked: settings.scrollbackCache
+                Layout.alignment: Qt.AlignRight
+            }
+
             Label {
                 Layout.alignment: Qt.AlignLeft
                 text: qsTr("Align nick length")